@@ -0,0 +1,350 @@
+#include<glad/glad.h>
+#include<GLFW/glfw3.h>
+#include"../OpenGLPlayingWithShaders/RenderContext.h"
+#include"../OpenGLPlayingWithShaders/GLStateCache.h"
+#include"../OpenGLPlayingWithShaders/MeshBatcher.h"
+#include"../OpenGLPlayingWithShaders/VertexLayout.h"
+#include"../OpenGLPlayingWithShaders/Shader.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+//Renders a few parameterized scenes for a fixed number of frames and reports the frame times as JSON.
+//It runs headless by default, so it works the same on a desktop, a CI runner or Mesa llvmpipe.
+//Only Benchmark.vcxproj builds it for now, Linux needs a build by hand (see RenderContext.h).
+//Usage: Benchmark [--scene name] [--count 100,1000] [--frames 300] [--warmup 10] [--output file.json] [--window]
+//Scenes (count = N):
+//  triangles   N triangles in a single draw call
+//  draw_calls  N meshes, one draw call each
+//  programs    N meshes, each drawn with its own program
+//  uniforms    N meshes, one program, a uniform update before each draw
+//The meshes are the triangle and rectangle from FirstOpenGLProgram, shrunk onto a grid.
+
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+
+const char* vertexShaderSource = "#version 330 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+"void main() {\n"
+"gl_Position = vec4(aPos, 1.0);\n"
+"}\n";
+const char* fragmentShaderSource = "#version 330 core\n"
+"uniform vec4 customColor;\n"
+"out vec4 RGBA;\n"
+"void main() {\n"
+"	RGBA = customColor;\n"
+"}\n";
+//Hashed at compile time, so the uniform scenes measure the setter and not the hashing
+constexpr UniformHandle customColor("customColor");
+
+const float v_triangle[]{
+	-0.5f, -0.5f, 0.0f,
+	0.5f, -0.5f, 0.0f,
+	0.0f, 0.5f, 0.0f
+};
+const float v_rectangle[]{
+	0.5f, 0.5f, 0.0f, //top right
+	0.5f, -0.5f, 0.0f, //bottom right
+	-0.5f, -0.5f, 0.0f, //bottom left
+	-0.5f, 0.5f, 0.0f //top left
+};
+const unsigned int i_rectangle[]{
+	0, 1, 3,
+	1, 2, 3
+};
+
+GLStateCache glState;
+
+struct BenchmarkOptions {
+	std::vector<std::string> scenes;
+	std::vector<unsigned int> counts;
+	unsigned int frames = 300;
+	unsigned int warmup = 10;
+	std::string output;
+	bool window = false;
+};
+
+struct SceneResult {
+	std::string scene;
+	unsigned int count;
+	unsigned int drawsPerFrame;
+	unsigned int uniformsPerFrame;
+	//Milliseconds, one per measured frame
+	std::vector<double> frameTimes;
+	unsigned int stateIssued;
+	unsigned int stateElided;
+};
+
+typedef VertexLayout<Attr<0, 3>> PositionLayout;
+
+//One scene ready to draw, programs and mesh list depend on the scene. Owns its GL objects
+struct Scene {
+	MeshBatcher meshes = MeshBatcher(PositionLayout::stride);
+	std::vector<Shader> programs;
+	bool singleDraw = false;
+	bool uniformPerDraw = false;
+	unsigned int draws = 0;
+	unsigned int uniforms = 0;
+};
+
+//Copies the shape into grid cell "cell" of a grid with "columns" cells per side
+void placeInCell(const float* source, unsigned int vertexCount, unsigned int cell, unsigned int columns, std::vector<float>& out) {
+	float size = 2.0f / columns;
+	float x = -1.0f + (cell % columns + 0.5f) * size;
+	float y = -1.0f + (cell / columns + 0.5f) * size;
+	for (unsigned int v = 0; v < vertexCount; v++) {
+		out.push_back(x + source[v * 3] * size * 0.9f);
+		out.push_back(y + source[v * 3 + 1] * size * 0.9f);
+		out.push_back(0.0f);
+	}
+}
+
+void buildScene(Scene& scene, const std::string& name, unsigned int count) {
+	unsigned int columns = (unsigned int)ceil(sqrt((double)count));
+	scene.meshes.addAttributes(PositionLayout::getAttributes());
+
+	std::vector<float> vertices;
+	if (name == "triangles") {
+		for (unsigned int i = 0; i < count; i++) {
+			placeInCell(v_triangle, 3, i, columns, vertices);
+		}
+		scene.meshes.addMesh(vertices.data(), count * 3, NULL, 0);
+		scene.singleDraw = true;
+	}
+	else {
+		//Alternate the two shapes so both the indexed and the plain path get drawn
+		for (unsigned int i = 0; i < count; i++) {
+			vertices.clear();
+			if (i % 2 == 0) {
+				placeInCell(v_triangle, 3, i, columns, vertices);
+				scene.meshes.addMesh(vertices.data(), 3, NULL, 0);
+			}
+			else {
+				placeInCell(v_rectangle, 4, i, columns, vertices);
+				scene.meshes.addMesh(vertices.data(), 4, i_rectangle, 6);
+			}
+		}
+	}
+	scene.meshes.upload(glState);
+
+	unsigned int programCount = name == "programs" ? count : 1;
+	scene.programs.reserve(programCount);
+	for (unsigned int i = 0; i < programCount; i++) {
+		//A different constant per program, so the driver can't share them
+		std::string fragment = fragmentShaderSource;
+		fragment.replace(fragment.find("RGBA = customColor;"), strlen("RGBA = customColor;"),
+			"RGBA = customColor * " + std::to_string(1.0f - (float)i / (programCount + 1)) + ";");
+		scene.programs.emplace_back(std::string(vertexShaderSource), fragment, (ShaderCache*)NULL);
+	}
+	scene.uniformPerDraw = name == "uniforms";
+	scene.draws = scene.singleDraw ? 1 : count;
+	scene.uniforms = scene.uniformPerDraw ? count : programCount;
+}
+
+void drawScene(Scene& scene) {
+	if (scene.singleDraw) {
+		scene.programs[0].use(glState);
+		scene.programs[0].setVec4(customColor, 1.0f, 0.5f, 0.2f, 1.0f);
+		scene.meshes.draw(glState, 0);
+		return;
+	}
+	if (scene.programs.size() == 1 && !scene.uniformPerDraw) {
+		scene.programs[0].use(glState);
+		scene.programs[0].setVec4(customColor, 1.0f, 0.5f, 0.2f, 1.0f);
+	}
+	unsigned int meshCount = scene.meshes.meshCount();
+	for (unsigned int i = 0; i < meshCount; i++) {
+		if (scene.programs.size() > 1) {
+			scene.programs[i].use(glState);
+			scene.programs[i].setVec4(customColor, 1.0f, 0.5f, 0.2f, 1.0f);
+		}
+		else if (scene.uniformPerDraw) {
+			scene.programs[0].use(glState);
+			float t = (float)i / meshCount;
+			scene.programs[0].setVec4(customColor, t, 1.0f - t, 0.2f, 1.0f);
+		}
+		scene.meshes.draw(glState, i);
+	}
+}
+
+SceneResult runScene(RenderContext& context, const BenchmarkOptions& options, const std::string& name, unsigned int count) {
+	Scene scene;
+	buildScene(scene, name, count);
+
+	SceneResult result;
+	result.scene = name;
+	result.count = count;
+	result.drawsPerFrame = scene.draws;
+	result.uniformsPerFrame = scene.uniforms;
+	result.frameTimes.reserve(options.frames);
+
+	for (unsigned int frame = 0; frame < options.warmup + options.frames; frame++) {
+		if (frame == options.warmup) {
+			glState.resetCounters();
+		}
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		glState.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		drawScene(scene);
+		//Wait for the GPU, so the time covers the whole frame and not just submitting it
+		glFinish();
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		context.endFrame();
+		if (frame >= options.warmup) {
+			result.frameTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		}
+	}
+	result.stateIssued = glState.issuedCalls;
+	result.stateElided = glState.elidedCalls;
+
+	//The scene's programs, VAO and buffers are freed when it goes out of scope
+	return result;
+}
+
+//Nearest rank percentile of sorted values
+double percentile(const std::vector<double>& sorted, double p) {
+	if (sorted.empty()) {
+		return 0.0;
+	}
+	size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+std::string jsonString(const char* text) {
+	std::string out = "\"";
+	for (const char* c = text != NULL ? text : ""; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\') {
+			out += '\\';
+		}
+		out += (unsigned char)*c < 0x20 ? ' ' : *c;
+	}
+	return out + "\"";
+}
+
+void writeJson(std::ostream& out, const BenchmarkOptions& options, const std::vector<SceneResult>& results) {
+	out << "{\n";
+	out << "  \"renderer\": " << jsonString((const char*)glGetString(GL_RENDERER)) << ",\n";
+	out << "  \"version\": " << jsonString((const char*)glGetString(GL_VERSION)) << ",\n";
+	out << "  \"width\": " << SCR_WIDTH << ",\n";
+	out << "  \"height\": " << SCR_HEIGHT << ",\n";
+	out << "  \"warmup_frames\": " << options.warmup << ",\n";
+	out << "  \"frames\": " << options.frames << ",\n";
+	out << "  \"scenes\": [";
+	for (size_t i = 0; i < results.size(); i++) {
+		const SceneResult& result = results[i];
+		std::vector<double> sorted = result.frameTimes;
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (double time : sorted) {
+			total += time;
+		}
+		double mean = sorted.empty() ? 0.0 : total / sorted.size();
+		double frames = (double)(sorted.empty() ? 1 : sorted.size());
+
+		out << (i > 0 ? ",\n" : "\n") << "    {\n";
+		out << "      \"scene\": " << jsonString(result.scene.c_str()) << ",\n";
+		out << "      \"count\": " << result.count << ",\n";
+		out << "      \"frame_ms\": { \"mean\": " << mean << ", \"p50\": " << percentile(sorted, 50.0)
+			<< ", \"p99\": " << percentile(sorted, 99.0) << ", \"min\": " << (sorted.empty() ? 0.0 : sorted.front())
+			<< ", \"max\": " << (sorted.empty() ? 0.0 : sorted.back()) << " },\n";
+		out << "      \"draw_calls_per_second\": " << (mean > 0.0 ? result.drawsPerFrame * 1000.0 / mean : 0.0) << ",\n";
+		out << "      \"calls_per_frame\": { \"draw\": " << result.drawsPerFrame << ", \"uniform\": " << result.uniformsPerFrame
+			<< ", \"state_issued\": " << result.stateIssued / frames << ", \"state_elided\": " << result.stateElided / frames << " }\n";
+		out << "    }";
+	}
+	out << "\n  ]\n}\n";
+}
+
+std::vector<std::string> splitList(const char* list) {
+	std::vector<std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ',')) {
+		if (!item.empty()) {
+			items.push_back(item);
+		}
+	}
+	return items;
+}
+
+BenchmarkOptions parseOptions(int argc, char** argv) {
+	BenchmarkOptions options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--scene" && hasValue) {
+			options.scenes = splitList(argv[++i]);
+		}
+		else if (arg == "--count" && hasValue) {
+			for (const std::string& count : splitList(argv[++i])) {
+				options.counts.push_back((unsigned int)strtoul(count.c_str(), NULL, 10));
+			}
+		}
+		else if (arg == "--frames" && hasValue) {
+			options.frames = (unsigned int)strtoul(argv[++i], NULL, 10);
+		}
+		else if (arg == "--warmup" && hasValue) {
+			options.warmup = (unsigned int)strtoul(argv[++i], NULL, 10);
+		}
+		else if (arg == "--output" && hasValue) {
+			options.output = argv[++i];
+		}
+		else if (arg == "--window") {
+			options.window = true;
+		}
+	}
+	if (options.scenes.empty()) {
+		options.scenes = { "triangles", "draw_calls", "programs", "uniforms" };
+	}
+	if (options.counts.empty()) {
+		options.counts = { 100, 1000 };
+	}
+	return options;
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkOptions options = parseOptions(argc, argv);
+
+	RenderContext context;
+	context.parseArguments(argc, argv);
+	context.setHeadless(!options.window);
+	if (!context.create("Benchmark", SCR_WIDTH, SCR_HEIGHT)) {
+		return -1;
+	}
+	//Don't let vsync decide the frame time when running in a window
+	if (options.window) {
+		glfwSwapInterval(0);
+	}
+
+	std::vector<SceneResult> results;
+	for (const std::string& scene : options.scenes) {
+		if (scene != "triangles" && scene != "draw_calls" && scene != "programs" && scene != "uniforms") {
+			std::cerr << "Unknown scene " << scene << std::endl;
+			context.destroy();
+			return -1;
+		}
+		for (unsigned int count : options.counts) {
+			std::cerr << "Running " << scene << " x" << count << std::endl;
+			results.push_back(runScene(context, options, scene, count));
+		}
+	}
+
+	if (options.output.empty()) {
+		writeJson(std::cout, options, results);
+	}
+	else {
+		std::ofstream file(options.output);
+		writeJson(file, options, results);
+	}
+
+	context.destroy();
+	return 0;
+}
@@ -2,6 +2,9 @@
 //
 #include<glad/glad.h>
 #include<GLFW/glfw3.h>
+#include "../OpenGLPlayingWithShaders/Renderer.h"
+#include "../OpenGLPlayingWithShaders/ShaderCompiler.h"
+#include "../OpenGLPlayingWithShaders/MeshBatcher.h"
 #include <iostream>
 
 const unsigned int SCR_WIDTH = 800;
@@ -23,98 +26,29 @@ const char* fragmentShaderYellowSource = "#version 330 core\n"
 "	RGBA = vec4(0.8f, 0.7f, 0.2f, 1.0f);\n"
 "}\0";
 
-void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-	glViewport(0, 0, width, height);
-}
-
-void processInput(GLFWwindow* window) {
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-		glfwSetWindowShouldClose(window, true);
-	}
-}
-
-void shaderCompile(unsigned int shader, const char* shaderSource, const char* message) {
-	int success;
-	char infoLog[512];
-
-	//Attach the shader source code to the object and compile it
-	glShaderSource(shader, 1, &shaderSource, NULL);
-	glCompileShader(shader);
-
-	//Check if compiled succesfully
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-
-	if (!success) {
-		glGetShaderInfoLog(shader, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::" << message << "::COMPILATION_FAILED\n" << infoLog << std::endl;
-	}
-}
-
-void shaderProgramCompile(unsigned int shaderProgram) {
-	glLinkProgram(shaderProgram);
-
-	//Check for compile errors
-	int success;
-	char infoLog[512];
-	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-	if (!success) {
-		glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::PROGRAM::COMPILATION_FAILED" << infoLog << std::endl;
-	}
-}
-
-int main()
+int main(int argc, char** argv)
 {
 	///////////
 	// SETUP //
 	///////////
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Hello OpenGL", NULL, NULL);
-	//Checks if window is not created, print message, terminate glfw.
-	if (window == NULL) {
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
-		return -1;
-	}
-	glfwMakeContextCurrent(window);
-	//set the function we created to be called on every window resize.
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-	//Load GLAD, with GLFW passing the address of the OpenGL functions for it to load
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-		std::cout << "Failed to initiate GLAD" << std::endl;
-		glfwTerminate();
+	//A window, or an offscreen framebuffer when run with --headless
+	Renderer renderer;
+	if (!renderer.init(argc, argv, "Hello OpenGL", SCR_WIDTH, SCR_HEIGHT)) {
 		return -1;
 	}
 	//\/\/\/\/\/\/\/\/\/\//
 	//      SHADERS      //
 	//\/\/\/\/\/\/\/\/\/\//
-	//Create and compile Vertex shader
-	unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	shaderCompile(vertexShader, vertexShaderSource, "VERTEX");
-	//Create and compile fragment shader
-	unsigned int fragmentShaderOrange = glCreateShader(GL_FRAGMENT_SHADER);
-	shaderCompile(fragmentShaderOrange, fragmentShaderOrangeSource, "FRAGMENT");
-	//Create and compile fragment shader
-	unsigned int fragmentShaderYellow = glCreateShader(GL_FRAGMENT_SHADER);
-	shaderCompile(fragmentShaderYellow, fragmentShaderYellowSource, "FRAGMENT");
-	//SHADER PROGRAM
-	unsigned int shaderProgramOrange = glCreateProgram();
-	unsigned int shaderProgramYellow = glCreateProgram();
-	//Attach the shaders into the program and run the linker
-	glAttachShader(shaderProgramOrange, vertexShader);
-	glAttachShader(shaderProgramOrange, fragmentShaderOrange);
-	shaderProgramCompile(shaderProgramOrange);
-	//Attach the shaders into the program and run the linker
-	glAttachShader(shaderProgramYellow, vertexShader);
-	glAttachShader(shaderProgramYellow, fragmentShaderYellow);
-	shaderProgramCompile(shaderProgramYellow);
-	//Delete the shaders, since it is already linked to the program they won't be used anymore
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShaderOrange);
-	glDeleteShader(fragmentShaderYellow);
+	//Submit both programs at once, nothing waits on the driver until the status is needed
+	ShaderCompiler shaderCompiler;
+	shaderCompiler.init(renderer.context.loader());
+	unsigned int orangeHandle = shaderCompiler.submit(vertexShaderSource, fragmentShaderOrangeSource, "ORANGE");
+	unsigned int yellowHandle = shaderCompiler.submit(vertexShaderSource, fragmentShaderYellowSource, "YELLOW");
+	//The renderer frees both programs on shutdown
+	renderer.adoptProgram(shaderCompiler.detach(orangeHandle));
+	renderer.adoptProgram(shaderCompiler.detach(yellowHandle));
+	//Orange is the fallback, so it is the only one we block on
+	unsigned int shaderProgramOrange = shaderCompiler.wait(orangeHandle);
 	//\/\/\/\/\/\/\/\/\/\//
 	//    VERTEX DATA    //
 	//\/\/\/\/\/\/\/\/\/\//
@@ -128,51 +62,23 @@ int main()
 		1.0f, -0.5f, 0.0f, //bottom right
 		0.5f, 0.5f, 0.0f //middle top
 	};
-	//Create VAO (Vertex Array Object)
-	unsigned int VAO[2], VBO[2];
-	glGenVertexArrays(2, VAO);
-	glGenBuffers(2, VBO);
-	//TRIANGLE 1
-	glBindVertexArray(VAO[0]);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(v_triangle1), v_triangle1, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//glBindVertexArray(0); //No need to bind since we are setting up another VAO
-	//TRIANGLE 2
-	glBindVertexArray(VAO[1]);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(v_triangle2), v_triangle2, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	//Both triangles live in one VAO/VBO, each is still its own mesh so it can use its own program
+	typedef VertexLayout<Attr<0, 3>> PositionLayout;
+	PositionLayout::validate(shaderProgramOrange, "ORANGE");
+	MeshBatcher triangles(PositionLayout::stride);
+	triangles.addAttributes(PositionLayout::getAttributes());
+	unsigned int triangle1 = triangles.addMesh(v_triangle1, 3, NULL, 0);
+	unsigned int triangle2 = triangles.addMesh(v_triangle2, 3, NULL, 0);
+	triangles.upload(renderer.state);
 	/////////////////
 	// RENDER LOOP //
 	/////////////////
-	while (!glfwWindowShouldClose(window)) {
-		//Input
-		processInput(window);
-
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-
+	renderer.run([&]() {
 		//Draw the object
-		glUseProgram(shaderProgramOrange);
-		glBindVertexArray(VAO[0]);
-		//Draw triangle primitives, starting at index 0 on the VAO, using 3 vertices
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-
-		glUseProgram(shaderProgramYellow);
-		glBindVertexArray(VAO[1]);
-		//Draw triangle primitives, starting at index 0 on the VAO, using 3 vertices
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+		renderer.draw(shaderProgramOrange, triangles.getMesh(triangle1));
+		//Yellow triangle is drawn orange until its program is linked (one merged draw call until then)
+		renderer.draw(shaderCompiler.programOr(yellowHandle, shaderProgramOrange), triangles.getMesh(triangle2));
+	});
 
-		//Call Events and Buffer Swap
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-	}
-
-	glfwTerminate();
 	return 0;
-}
\ No newline at end of file
+}
@@ -1,7 +1,15 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include "../OpenGLPlayingWithShaders/Renderer.h"
 #include <iostream>
-#include "main.h"
+#include <cmath>
+#include "../OpenGLPlayingWithShaders/MeshBatcher.h"
+#include "../OpenGLPlayingWithShaders/FixedTimestep.h"
+#include "../OpenGLPlayingWithShaders/SoftwareRasterizer.h"
+#include "../OpenGLPlayingWithShaders/MeshOptimizer.h"
+#include "../OpenGLPlayingWithShaders/MeshFile.h"
+#include <cstring>
+#include <chrono>
 
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
@@ -19,187 +27,172 @@ const char* fragmentShaderSource = "#version 330 core\n"
 "	RGBA = customColor;\n"
 "}\0";
 
-void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-	glViewport(0, 0, width, height);
+//\/\/\/\/\/\/\/\/\/\//
+//    VERTEX DATA    //
+//\/\/\/\/\/\/\/\/\/\//
+
+//Create the Normalized Device Coordinates NDC
+const float vertices[] {
+	-0.5f, -0.5f, 0.0f, //bottom left
+	0.5f, -0.5f, 0.0f, //bottom right
+	0.0f, 0.5f, 0.0f //middle top
+};
+
+//Create a EBO for a rectangle
+const float recVertices[]{
+	0.7f, 0.7f, 0.0f, //top right
+	0.7f, 0.5f, 0.0f, //bottom right
+	0.5f, 0.5f, 0.0f, //bottom left
+	0.5f, 0.7f, 0.0f //top left
+};
+const unsigned int indices[]{
+	0, 1, 3,
+	1, 2, 3
+};
+
+//The rectangle as it is uploaded: deduplicated and reordered for the vertex cache and fetches at load time.
+//A shape this small gains nothing, but imported meshes go through the same call
+void loadRectangle(std::vector<unsigned char>& meshVertices, std::vector<unsigned int>& meshIndices) {
+	meshVertices.assign((const unsigned char*)recVertices, (const unsigned char*)recVertices + sizeof(recVertices));
+	meshIndices.assign(indices, indices + 6);
+	MeshOptimizer::optimizeMesh(meshVertices, 3 * sizeof(float), meshIndices, 0).print("RECTANGLE");
 }
 
-void processInput(GLFWwindow* window) {
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-		glfwSetWindowShouldClose(window, true);
+//A mesh written by MeshConverter (positions at location 0), mapped and uploaded without parsing
+bool loadMeshFile(Renderer& renderer, const char* path, Mesh& mesh) {
+	auto start = std::chrono::steady_clock::now();
+	MeshFile file;
+	if (!file.open(path)) {
+		return false;
 	}
+	const MeshFileHeader& header = file.getHeader();
+	const void* meshVertices = file.getVertices();
+	const void* meshIndices = file.getIndices();
+	if (meshVertices == NULL || (header.indexCount > 0 && meshIndices == NULL)) {
+		return false;
+	}
+	mesh = renderer.createMesh(meshVertices, header.vertexCount, header.vertexStride, meshIndices, header.indexCount,
+		header.indexType, file.getAttributes());
+	std::cout << "MESH_FILE::" << path << ": " << header.vertexCount << " vertices, " << header.indexCount << " indices"
+		<< (file.isCompressed() ? " (compressed)" : "") << " loaded in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+	return true;
 }
 
-void shaderCompile(unsigned int shader, const char* shaderSource, const char* message) {
-	int success;
-	char infoLog[512];
-
-	//Attach the shader source code to the object and compile it
-	glShaderSource(shader, 1, &shaderSource, NULL);
-	glCompileShader(shader);
+//Everything the update step animates, what the render loop draws from
+struct AnimationState {
+	float colorValue;
 
-	//Check if compiled succesfully
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-
-	if (!success) {
-		glGetShaderInfoLog(shader, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::" << message <<"::COMPILATION_FAILED\n" << infoLog << std::endl;
+	static AnimationState interpolate(const AnimationState& previous, const AnimationState& current, float alpha) {
+		AnimationState state = { previous.colorValue + (current.colorValue - previous.colorValue) * alpha };
+		return state;
 	}
+};
+
+void animate(AnimationState& state, double time, double /*step*/) {
+	// Get the green value in a sin so it gradually changes
+	state.colorValue = (sinf((float)time) / 2.0f) + 0.5f;
 }
 
-int main() {
-	//glfw initializes, we pass the minor and major version we want of OpenGL to run, which is version 3
-	//we also set the core profile as the default
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);	
-
-	//Creates window, 800x600 and sets the title
-	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Hello OpenGL", NULL, NULL);
-	//Checks if window is not created, print message, terminate glfw.
-	if (window == NULL) {
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
+//The same frames drawn by the CPU rasterizer, for --software or when there is no usable GL driver.
+//There is no window, it runs like --headless: --frames frames at 60 per second, the last one saved with --capture
+int renderSoftware(int argc, char** argv) {
+	RenderContext options;
+	options.parseArguments(argc, argv);
+	SoftwareRasterizer rasterizer;
+	if (!rasterizer.create(SCR_WIDTH, SCR_HEIGHT)) {
 		return -1;
 	}
+	FixedTimestep<AnimationState> animation(1.0 / 60.0);
+	AnimationState initial = { 0.5f };
+	animation.start(initial, animate, 0.0);
+
+	std::vector<unsigned char> rectangleVertices;
+	std::vector<unsigned int> rectangleIndices;
+	loadRectangle(rectangleVertices, rectangleIndices);
+	SoftwareVertexInput rectangle = { rectangleVertices.data(), 3 * sizeof(float), 0, -1, { 0.0f, 0.0f, 0.0f, 1.0f } };
+	SoftwareVertexInput triangle = { vertices, 3 * sizeof(float), 0, -1, { 0.0f, 0.0f, 0.0f, 1.0f } };
+	for (unsigned int frame = 0; frame < options.getMaxFrames(); frame++) {
+		float colorValue = animation.sample(frame / 60.0).colorValue;
+		rectangle.flatColor[0] = rectangle.flatColor[1] = colorValue;
+		triangle.flatColor[0] = triangle.flatColor[1] = colorValue;
+		rasterizer.clear(0.2f, 0.3f, 0.3f, 1.0f);
+		rasterizer.drawElements(rectangle, rectangleIndices.data(), (unsigned int)rectangleIndices.size());
+		rasterizer.drawArrays(triangle, 0, 3);
+	}
+	if (!options.getCapturePath().empty()) {
+		rasterizer.capture(options.getCapturePath().c_str());
+	}
+	std::cout << "SOFTWARE_RASTERIZER: " << options.getMaxFrames() << " frames, " << rasterizer.rejectedTriangles << " triangles rejected" << std::endl;
+	return 0;
+}
 
-	glfwMakeContextCurrent(window);
-	//set the function we created to be called on every window resize.
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--software") == 0) {
+			return renderSoftware(argc, argv);
+		}
+	}
 
-	//Load GLAD, with GLFW passing the address of the OpenGL functions for it to load
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-		std::cout << "Failed to initiate GLAD" << std::endl;
-		glfwTerminate();
-		return -1;
+	//A window, or an offscreen framebuffer when run with --headless
+	Renderer renderer;
+	if (!renderer.init(argc, argv, "Hello OpenGL", SCR_WIDTH, SCR_HEIGHT)) {
+		std::cout << "Falling back to the software rasterizer" << std::endl;
+		return renderSoftware(argc, argv);
 	}
 
 	//\/\/\/\/\/\/\/\/\/\//
 	//      SHADERS      //
 	//\/\/\/\/\/\/\/\/\/\//
-
-	//Create and compile Vertex shader
-	unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	shaderCompile(vertexShader, vertexShaderSource, "VERTEX");
-
-	//Create and compile fragment shader
-	unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	shaderCompile(fragmentShader, fragmentShaderSource, "FRAGMENT");
-
-	//SHADER PROGRAM
-	unsigned int shaderProgram = glCreateProgram();
-
-	//Attach the shaders into the program and run the linker
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	glLinkProgram(shaderProgram);
-
-	//Check for compile errors
-	int success;
-	char infoLog[512];
-	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-	if (!success) {
-		glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::PROGRAM::COMPILATION_FAILED" << infoLog << std::endl;
+	unsigned int shaderProgram = renderer.createProgram(vertexShaderSource, fragmentShaderSource, "PROGRAM");
+
+	//Both shapes share one VAO, VBO and EBO, the triangle is stored after the rectangle
+	typedef VertexLayout<Attr<0, 3>> PositionLayout;
+	PositionLayout::validate(shaderProgram, "PROGRAM");
+	MeshBatcher shapes(PositionLayout::stride);
+	shapes.addAttributes(PositionLayout::getAttributes());
+	std::vector<unsigned char> rectangleVertices;
+	std::vector<unsigned int> rectangleIndices;
+	loadRectangle(rectangleVertices, rectangleIndices);
+	shapes.addMesh(rectangleVertices.data(), (unsigned int)(rectangleVertices.size() / PositionLayout::stride),
+		rectangleIndices.data(), (unsigned int)rectangleIndices.size());
+	//No indices, so the batcher generates 0, 1, 2
+	shapes.addMesh(vertices, 3, NULL, 0);
+	shapes.upload(renderer.state);
+
+	//--mesh file.mesh draws a converted mesh along with the shapes
+	Mesh loadedMesh = {};
+	bool hasLoadedMesh = false;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "--mesh") == 0) {
+			hasLoadedMesh = loadMeshFile(renderer, argv[i + 1], loadedMesh);
+		}
 	}
 
-	//Delete the shaders, since it is already linked to the program they won't be used anymore
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
-
-	//\/\/\/\/\/\/\/\/\/\//
-	//    VERTEX DATA    //
-	//\/\/\/\/\/\/\/\/\/\//
-
-	//Create the Normalized Device Coordinates NDC
-	float vertices[] {
-		-0.5f, -0.5f, 0.0f, //bottom left
-		0.5f, -0.5f, 0.0f, //bottom right
-		0.0f, 0.5f, 0.0f //middle top
-	};
+	//Uniform locations never change after linking, so look them up once instead of every frame
+	int vertexColorLocation = glGetUniformLocation(shaderProgram, "customColor");
 
-	//Create a EBO for a rectangle
-	float recVertices[]{
-		0.7f, 0.7f, 0.0f, //top right
-		0.7f, 0.5f, 0.0f, //bottom right
-		0.5f, 0.5f, 0.0f, //bottom left
-		0.5f, 0.7f, 0.0f //top left
-	};
-	unsigned int indices[]{
-		0, 1, 3,
-		1, 2, 3
-	};
-
-	//Create VAO (Vertex Array Object)
-	unsigned int VAO[2], VBO[2];
-
-	//Create EBO (Element Buffer Object)
-	unsigned int EBO;
-
-	glGenVertexArrays(2, VAO);
-	glBindVertexArray(VAO[0]);
-
-	glGenBuffers(2, VBO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(recVertices), recVertices, GL_STATIC_DRAW);
-
-	glGenBuffers(1, &EBO);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	//Bind the VAO | All VBOs will be stored here from now on
-	glBindVertexArray(VAO[1]);
-
-	//Bind the buffer object to the ARRAY_BUFFER type, which is a VBO type
-	glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-
-	//Copy the vertex data to GPU memory | If the data was to change a lot of times, use GL_DYNAMIC_DRAW instead
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	//Show OpenGL how to interpret the vertex data
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	//Update loop, 60 steps per second no matter the frame rate (--update-thread runs it on its own thread)
+	FixedTimestep<AnimationState> animation(1.0 / 60.0);
+	animation.parseArguments(argc, argv);
+	AnimationState initial = { 0.5f };
+	animation.start(initial, animate, renderer.context.getTime());
 
 	//Render loop
-	while (!glfwWindowShouldClose(window)) {
-		//Input
-		processInput(window);
-
-		/////////////
-		//Rendering//
-		/////////////
-		//Clear the screen to a specific color (the example is a green)
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		// Get the green value in a sin so it gradually changes
-		float timeValue = glfwGetTime();
-		float colorValue = (sin(timeValue) / 2.0f) + 0.5f;
-		int vertexColorLocation = glGetUniformLocation(shaderProgram, "customColor");
-
-		//Draw the object
-		glUseProgram(shaderProgram);
-		glUniform4f(vertexColorLocation, colorValue, colorValue, 0.0f, 1.0f);
-
-		glBindVertexArray(VAO[0]);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-		glBindVertexArray(VAO[1]);
-		//Draw triangle primitives, starting at index 0 on the VAO, using 3 vertices
-		glDrawArrays(GL_TRIANGLES, 0, 3);
-
-		//Call Events and Buffer Swap
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-	}
+	renderer.run([&]() {
+		float colorValue = animation.sample(renderer.context.getTime()).colorValue;
+
+		//Every shape is recorded the same way, so recording can be spread over the job threads once there are
+		//enough of them. Same program, VAO and color, so they are still sent in a single draw call
+		renderer.record(shapes.meshCount(), [&](CommandList& list, unsigned int i) {
+			list.draw(shaderProgram, shapes.getMesh(i)).setColor(vertexColorLocation, colorValue, colorValue, 0.0f, 1.0f);
+		});
+		if (hasLoadedMesh) {
+			renderer.draw(shaderProgram, loadedMesh).setColor(vertexColorLocation, 0.0f, colorValue, colorValue, 1.0f);
+		}
+	});
+	animation.stop();
+	animation.printStats();
 
-	glfwTerminate();
 	return 0;
-}
\ No newline at end of file
+}
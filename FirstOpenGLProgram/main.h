@@ -1,4 +0,0 @@
-#pragma once
-#include <GLFW/glfw3.h>
-
-void framebuffer_size_callback(GLFWwindow* window, int width, int height);
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include<glad/glad.h>
+#include"../OpenGLPlayingWithShaders/MeshFile.h"
+#include"../OpenGLPlayingWithShaders/MeshOptimizer.h"
+#include"../OpenGLPlayingWithShaders/VertexFormat.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+//Turns a Wavefront OBJ into a .mesh file (see MeshFile.h): optimized for the vertex cache and fetches, packed in the
+//GPU formats and laid out so loading is a memory map and a glBufferData.
+//Usage: MeshConverter input.obj output.mesh [--half] [--compress]
+//       MeshConverter --info file.mesh
+//Attributes: position at location 0 (float, or half with --half), normal at 1 (10_10_10_2) and texture coordinate
+//at 2 (half) when the OBJ has them. Indices are 16-bit when there are at most 65536 vertices, 32-bit otherwise.
+//--compress stores the blobs as LZ4 chunks: smaller on disk, but loading decompresses instead of mapping.
+
+struct ObjMesh {
+	//Per vertex: position, then texture coordinate and normal if present
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+	bool hasTexCoords = false;
+	bool hasNormals = false;
+};
+
+//Resolves a 1-based (or negative, from the end) OBJ index, -1 if missing or out of range
+int objIndex(const std::string& text, size_t count) {
+	if (text.empty()) {
+		return -1;
+	}
+	int index = atoi(text.c_str());
+	int resolved = index < 0 ? (int)count + index : index - 1;
+	return resolved >= 0 && resolved < (int)count ? resolved : -1;
+}
+
+//Triangulates faces as fans, every face corner becomes its own vertex (MeshOptimizer merges the duplicates)
+bool loadObj(const char* path, ObjMesh& mesh) {
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "ERROR::MESH_CONVERTER::FILE_NOT_FOUND\n" << path << std::endl;
+		return false;
+	}
+	std::vector<float> positions;
+	std::vector<float> texCoords;
+	std::vector<float> normals;
+	//Corners as position, texture coordinate, normal indices
+	std::vector<int> corners;
+
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream stream(line);
+		std::string keyword;
+		stream >> keyword;
+		if (keyword == "v") {
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			stream >> x >> y >> z;
+			positions.insert(positions.end(), { x, y, z });
+		}
+		else if (keyword == "vt") {
+			float u = 0.0f, v = 0.0f;
+			stream >> u >> v;
+			texCoords.insert(texCoords.end(), { u, v });
+		}
+		else if (keyword == "vn") {
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			stream >> x >> y >> z;
+			normals.insert(normals.end(), { x, y, z });
+		}
+		else if (keyword == "f") {
+			std::vector<int> face;
+			std::string corner;
+			while (stream >> corner) {
+				//v, v/vt, v//vn or v/vt/vn
+				size_t firstSlash = corner.find('/');
+				size_t secondSlash = firstSlash == std::string::npos ? std::string::npos : corner.find('/', firstSlash + 1);
+				std::string position = corner.substr(0, firstSlash);
+				std::string texCoord = firstSlash == std::string::npos ? "" : corner.substr(firstSlash + 1, secondSlash - firstSlash - 1);
+				std::string normal = secondSlash == std::string::npos ? "" : corner.substr(secondSlash + 1);
+				int positionIndex = objIndex(position, positions.size() / 3);
+				if (positionIndex < 0) {
+					std::cout << "ERROR::MESH_CONVERTER::BAD_FACE\n" << line << std::endl;
+					return false;
+				}
+				face.insert(face.end(), { positionIndex, objIndex(texCoord, texCoords.size() / 2), objIndex(normal, normals.size() / 3) });
+			}
+			for (size_t i = 2; i < face.size() / 3; i++) {
+				corners.insert(corners.end(), face.begin(), face.begin() + 3);
+				corners.insert(corners.end(), face.begin() + (i - 1) * 3, face.begin() + (i + 1) * 3);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < corners.size(); i += 3) {
+		mesh.hasTexCoords |= corners[i + 1] >= 0;
+		mesh.hasNormals |= corners[i + 2] >= 0;
+	}
+	for (size_t i = 0; i < corners.size(); i += 3) {
+		const float* position = &positions[corners[i] * 3];
+		mesh.vertices.insert(mesh.vertices.end(), position, position + 3);
+		if (mesh.hasTexCoords) {
+			const float* texCoord = corners[i + 1] >= 0 ? &texCoords[corners[i + 1] * 2] : NULL;
+			mesh.vertices.insert(mesh.vertices.end(), { texCoord ? texCoord[0] : 0.0f, texCoord ? texCoord[1] : 0.0f });
+		}
+		if (mesh.hasNormals) {
+			const float* normal = corners[i + 2] >= 0 ? &normals[corners[i + 2] * 3] : NULL;
+			mesh.vertices.insert(mesh.vertices.end(), { normal ? normal[0] : 0.0f, normal ? normal[1] : 0.0f, normal ? normal[2] : 1.0f });
+		}
+		mesh.indices.push_back((unsigned int)(i / 3));
+	}
+	return true;
+}
+
+int printInfo(const char* path) {
+	MeshFile file;
+	if (!file.open(path)) {
+		return -1;
+	}
+	const MeshFileHeader& header = file.getHeader();
+	std::cout << path << ": " << header.vertexCount << " vertices of " << header.vertexStride << " bytes, "
+		<< header.indexCount << (header.indexType == GL_UNSIGNED_SHORT ? " 16-bit" : " 32-bit") << " indices"
+		<< (file.isCompressed() ? ", compressed" : "") << std::endl;
+	std::cout << "bounds: (" << header.boundsMin[0] << ", " << header.boundsMin[1] << ", " << header.boundsMin[2] << ") - ("
+		<< header.boundsMax[0] << ", " << header.boundsMax[1] << ", " << header.boundsMax[2] << ")" << std::endl;
+	for (const VertexAttribute& attribute : file.getAttributes()) {
+		std::cout << "attribute " << attribute.index << ": " << attribute.size << " x 0x" << std::hex << attribute.type << std::dec
+			<< (attribute.normalized ? " normalized" : "") << " at " << attribute.offset << std::endl;
+	}
+	if (file.getVertices() == NULL || (header.indexCount > 0 && file.getIndices() == NULL)) {
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	if (argc == 3 && strcmp(argv[1], "--info") == 0) {
+		return printInfo(argv[2]);
+	}
+	if (argc < 3) {
+		std::cout << "Usage: MeshConverter input.obj output.mesh [--half] [--compress]\n"
+			<< "       MeshConverter --info file.mesh" << std::endl;
+		return -1;
+	}
+	bool halfPositions = false;
+	bool compress = false;
+	for (int i = 3; i < argc; i++) {
+		if (strcmp(argv[i], "--half") == 0) {
+			halfPositions = true;
+		}
+		else if (strcmp(argv[i], "--compress") == 0) {
+			compress = true;
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	ObjMesh obj;
+	if (!loadObj(argv[1], obj)) {
+		return -1;
+	}
+	if (obj.indices.empty()) {
+		std::cout << "ERROR::MESH_CONVERTER::NO_FACES\n" << argv[1] << std::endl;
+		return -1;
+	}
+
+	VertexFormat format;
+	format.addAttribute(0, 3, halfPositions ? VertexFormat::Half : VertexFormat::Float);
+	if (obj.hasTexCoords) {
+		format.addAttribute(2, 2, VertexFormat::Half);
+	}
+	if (obj.hasNormals) {
+		format.addAttribute(1, 3, VertexFormat::SNorm10_10_10_2);
+	}
+
+	//Optimize on the float vertices, so deduplication sees the exact values
+	unsigned int sourceStride = format.getSourceFloats();
+	std::vector<unsigned char> floatVertices((const unsigned char*)obj.vertices.data(),
+		(const unsigned char*)(obj.vertices.data() + obj.vertices.size()));
+	MeshOptimizer::optimizeMesh(floatVertices, sourceStride * sizeof(float), obj.indices, 0).print(argv[1]);
+	unsigned int vertexCount = (unsigned int)(floatVertices.size() / (sourceStride * sizeof(float)));
+	const float* source = (const float*)floatVertices.data();
+
+	MeshFileContents contents;
+	std::vector<unsigned char> packedVertices;
+	format.pack(source, sourceStride, vertexCount, packedVertices);
+	contents.vertices = packedVertices.data();
+	contents.vertexCount = vertexCount;
+	contents.vertexStride = format.getStride();
+	contents.attributes = format.getAttributes();
+	for (int c = 0; c < 3; c++) {
+		contents.boundsMin[c] = source[c];
+		contents.boundsMax[c] = source[c];
+	}
+	for (unsigned int v = 0; v < vertexCount; v++) {
+		for (int c = 0; c < 3; c++) {
+			float value = source[(size_t)v * sourceStride + c];
+			contents.boundsMin[c] = value < contents.boundsMin[c] ? value : contents.boundsMin[c];
+			contents.boundsMax[c] = value > contents.boundsMax[c] ? value : contents.boundsMax[c];
+		}
+	}
+
+	//The whole mesh fits 16-bit indices or none of it does, the file has no chunks
+	std::vector<uint16_t> shortIndices;
+	if (vertexCount <= 65536) {
+		shortIndices.assign(obj.indices.begin(), obj.indices.end());
+		contents.indices = shortIndices.data();
+		contents.indexType = GL_UNSIGNED_SHORT;
+	}
+	else {
+		contents.indices = obj.indices.data();
+		contents.indexType = GL_UNSIGNED_INT;
+	}
+	contents.indexCount = (unsigned int)obj.indices.size();
+
+	if (!MeshFile::write(argv[2], contents, compress)) {
+		std::cout << "ERROR::MESH_CONVERTER::WRITE_FAILED\n" << argv[2] << std::endl;
+		return -1;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "MESH_CONVERTER::" << argv[2] << ": " << vertexCount << " vertices of " << contents.vertexStride << " bytes, "
+		<< contents.indexCount << " indices, " << seconds * 1000.0 << " ms" << std::endl;
+	return printInfo(argv[2]);
+}
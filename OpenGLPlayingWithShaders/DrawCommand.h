@@ -0,0 +1,119 @@
+#ifndef DRAWCOMMAND_H
+
+#define DRAWCOMMAND_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+//Bytes per index of GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+inline unsigned int indexTypeSize(GLenum type) {
+	return type == GL_UNSIGNED_BYTE ? 1 : (type == GL_UNSIGNED_SHORT ? 2 : 4);
+}
+
+//Part of a mesh whose indices were rebased so they fit a smaller index type, see IndexBuffer
+struct MeshChunk {
+	unsigned int first;
+	GLsizei count;
+	GLint baseVertex;
+};
+
+//A drawable range of a vertex array, what Renderer::createMesh and MeshBatcher::getMesh hand out.
+//Indexed meshes use indexType indices starting at index "first", the others draw "count" vertices from vertex "first".
+//A mesh too big for its index type is drawn as chunkCount chunks instead (first and baseVertex are unused then),
+//the chunks live as long as whatever made the mesh.
+struct Mesh {
+	unsigned int vertexArray;
+	GLsizei count;
+	unsigned int first;
+	GLint baseVertex;
+	bool indexed;
+	GLenum indexType;
+	const MeshChunk* chunks;
+	unsigned int chunkCount;
+};
+
+//One recorded draw. Plain data, so recording a frame is just filling a vector and nothing touches GL
+//until the queue is submitted. Everything is drawn as GL_TRIANGLES.
+//pass, material and depth only decide where the draw lands in the sorted RenderQueue.
+struct DrawCommand {
+	unsigned int program;
+	unsigned int vertexArray;
+	GLsizei count;
+	unsigned int first;
+	GLint baseVertex;
+	GLsizei instanceCount;
+	bool indexed;
+	GLenum indexType;
+	//NULL unless the mesh is split, see Mesh
+	const MeshChunk* chunks;
+	unsigned int chunkCount;
+	//Optional vec4 uniform set before the draw, -1 for none
+	int colorLocation;
+	float color[4];
+	unsigned char pass;
+	unsigned short material;
+	float depth;
+
+	static DrawCommand make(unsigned int program, const Mesh& mesh) {
+		DrawCommand command = { program, mesh.vertexArray, mesh.count, mesh.first, mesh.baseVertex, 1, mesh.indexed, mesh.indexType,
+			mesh.chunks, mesh.chunkCount, -1, { 0.0f, 0.0f, 0.0f, 0.0f }, 0, 0, 0.0f };
+		return command;
+	}
+
+	DrawCommand& setColor(int location, float r, float g, float b, float a) {
+		colorLocation = location;
+		color[0] = r;
+		color[1] = g;
+		color[2] = b;
+		color[3] = a;
+		//Same color, same material, so equal colors sort next to each other and can merge
+		material = hashColor();
+		return *this;
+	}
+
+	//Overrides the material setColor picked
+	DrawCommand& setMaterial(unsigned short id) {
+		material = id;
+		return *this;
+	}
+
+	//0 to 15, all draws of a pass are submitted before the next pass
+	DrawCommand& setPass(unsigned char id) {
+		pass = id;
+		return *this;
+	}
+
+	//0 near to 1 far
+	DrawCommand& setDepth(float value) {
+		depth = value;
+		return *this;
+	}
+
+	DrawCommand& setInstances(GLsizei instances) {
+		instanceCount = instances;
+		return *this;
+	}
+
+	//True if both can go into the same glMultiDraw* call
+	bool canMergeWith(const DrawCommand& other) const {
+		return program == other.program && vertexArray == other.vertexArray && indexed == other.indexed
+			&& (!indexed || indexType == other.indexType) && instanceCount == 1 && other.instanceCount == 1
+			&& colorLocation == other.colorLocation
+			&& (colorLocation == -1 || (color[0] == other.color[0] && color[1] == other.color[1]
+				&& color[2] == other.color[2] && color[3] == other.color[3]));
+	}
+
+private:
+	//FNV-1a over the color bytes, folded to 16 bits
+	unsigned short hashColor() const {
+		const unsigned char* bytes = (const unsigned char*)color;
+		unsigned int hash = 2166136261u;
+		for (size_t i = 0; i < sizeof(color); i++) {
+			hash = (hash ^ bytes[i]) * 16777619u;
+		}
+		return (unsigned short)(hash ^ (hash >> 16));
+	}
+};
+
+#endif // !DRAWCOMMAND_H
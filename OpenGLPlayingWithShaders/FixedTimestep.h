@@ -0,0 +1,181 @@
+#ifndef FIXEDTIMESTEP_H
+
+#define FIXEDTIMESTEP_H
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+
+//Runs the simulation in fixed steps, independent of how fast frames are rendered, and hands the renderer a
+//state interpolated between the last two steps so motion stays smooth at any frame rate.
+//State must be copyable and have a static State interpolate(const State& previous, const State& current, float alpha).
+//
+//By default the steps run inside sample(), on the render thread. With --update-thread they run on their own
+//thread into a private pair of states, which is copied to the pair the renderer reads from (double buffered)
+//once it has caught up, so a slow update never blocks a frame and the other way around. The renderer then
+//draws what the last catch-up produced, up to a frame later than in the single thread mode.
+//Either way the simulation follows the time passed to sample(), so headless runs stay reproducible in the
+//single thread mode.
+template <typename State>
+class FixedTimestep {
+public:
+	//update(state, time, step): advance state by step seconds, time is the simulated time after the step
+	typedef std::function<void(State& state, double time, double step)> UpdateFunction;
+
+	//Steps taken so far
+	unsigned int updates = 0;
+	//Steps skipped because the simulation fell more than maxSteps behind (after a breakpoint, a hitch...)
+	unsigned int droppedSteps = 0;
+
+	FixedTimestep(double step = 1.0 / 60.0, unsigned int maxSteps = 8) : step(step), maxSteps(maxSteps) {}
+	~FixedTimestep() {
+		stop();
+	}
+	FixedTimestep(const FixedTimestep&) = delete;
+	FixedTimestep& operator=(const FixedTimestep&) = delete;
+
+	//Call before start()
+	void parseArguments(int argc, char** argv) {
+		for (int i = 1; i < argc; i++) {
+			if (strcmp(argv[i], "--update-thread") == 0) {
+				threaded = true;
+			}
+		}
+	}
+
+	//Call before start(), overrides what parseArguments() found
+	void setThreaded(bool threaded) {
+		this->threaded = threaded;
+	}
+
+	bool isThreaded() const {
+		return threaded;
+	}
+
+	//now is the render clock, the first step ends at now + step
+	void start(const State& initial, UpdateFunction update, double now) {
+		stop();
+		this->update = update;
+		previous = initial;
+		current = initial;
+		simulatedTime = now;
+		targetTime = now;
+		updates = 0;
+		droppedSteps = 0;
+		if (threaded) {
+			running = true;
+			thread = std::thread(&FixedTimestep::updateLoop, this);
+		}
+	}
+
+	void stop() {
+		if (!thread.joinable()) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		wake.notify_all();
+		thread.join();
+	}
+
+	//Catches the simulation up to now and returns the state to draw
+	State sample(double now) {
+		if (!threaded) {
+			targetTime = now;
+			advance(previous, current, simulatedTime, targetTime);
+			return State::interpolate(previous, current, alpha(now, simulatedTime));
+		}
+
+		State previousCopy;
+		State currentCopy;
+		double publishedTime;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			targetTime = now;
+			previousCopy = previous;
+			currentCopy = current;
+			publishedTime = simulatedTime;
+		}
+		wake.notify_all();
+		return State::interpolate(previousCopy, currentCopy, alpha(now, publishedTime));
+	}
+
+	void printStats() const {
+		std::cout << "FIXED_TIMESTEP: " << updates << " updates of " << step * 1000.0 << " ms, " << droppedSteps
+			<< " dropped" << (threaded ? " (update thread)" : "") << std::endl;
+	}
+
+private:
+	double step;
+	unsigned int maxSteps;
+	bool threaded = false;
+	UpdateFunction update;
+
+	//The renderer's pair, what sample() interpolates. In threaded mode guarded by mutex
+	State previous;
+	State current;
+	//Simulated time of current
+	double simulatedTime = 0.0;
+	//How far the simulation should have run, set by sample()
+	double targetTime = 0.0;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool running = false;
+
+	//Where now falls inside the last step, the simulation runs up to one step ahead and is blended back to now
+	float alpha(double now, double time) const {
+		double value = 1.0 - (time - now) / step;
+		return value < 0.0 ? 0.0f : (value > 1.0 ? 1.0f : (float)value);
+	}
+
+	//Steps until the simulation is at or past target, one step ahead of it at most
+	void advance(State& previousState, State& currentState, double& time, double target) {
+		unsigned int steps = 0;
+		while (time < target) {
+			if (steps == maxSteps) {
+				//Too far behind, give up on real time instead of spending every frame catching up
+				unsigned int skipped = (unsigned int)((target - time) / step);
+				droppedSteps += skipped;
+				time += skipped * step;
+				if (time >= target) {
+					break;
+				}
+			}
+			previousState = currentState;
+			time += step;
+			update(currentState, time, step);
+			updates++;
+			steps++;
+		}
+	}
+
+	void updateLoop() {
+		std::unique_lock<std::mutex> lock(mutex);
+		//The thread's own pair, only copied out under the lock once it has caught up
+		State workingPrevious = previous;
+		State working = current;
+		double time = simulatedTime;
+		while (true) {
+			wake.wait(lock, [&]() { return !running || time < targetTime; });
+			if (!running) {
+				return;
+			}
+			double target = targetTime;
+			lock.unlock();
+			advance(workingPrevious, working, time, target);
+			lock.lock();
+			previous = workingPrevious;
+			current = working;
+			simulatedTime = time;
+		}
+	}
+};
+
+#endif // !FIXEDTIMESTEP_H
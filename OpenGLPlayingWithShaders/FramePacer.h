@@ -0,0 +1,192 @@
+#ifndef FRAMEPACER_H
+
+#define FRAMEPACER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+//Controls when frames start, to trade throughput for input latency:
+//	--swap-interval N			0 no vsync, 1 vsync (default), -1 adaptive vsync (tears only when late) if supported
+//	--fps-limit F				start at most F frames per second, sleeps then spins for the last stretch
+//	--max-frames-in-flight N	how many submitted frames the GPU may still be working on when a new one starts,
+//								enforced with a fence per frame. 1 is the lowest latency, 0 turns the cap off
+//	--latency-log file.csv		per frame latency
+//Latency is measured from when a frame's input was polled to when its fence was seen signaled, so it covers
+//the CPU and GPU work of the frame but not the display scan out. A fence is only checked when the pacer runs,
+//so unless the pacer had to wait for it the value is an upper bound.
+class FramePacer {
+public:
+	int swapInterval = 1;
+	double fpsLimit = 0.0;
+	unsigned int maxFramesInFlight = 2;
+	//Time spun instead of slept before a limiter deadline, sleep is only accurate to about a millisecond
+	double spinSeconds = 0.002;
+	//Total time spent waiting, in milliseconds
+	double fenceWaitMs = 0.0;
+	double limiterWaitMs = 0.0;
+
+	//Call before init()
+	void parseArguments(int argc, char** argv) {
+		for (int i = 1; i + 1 < argc; i++) {
+			if (strcmp(argv[i], "--swap-interval") == 0) {
+				swapInterval = atoi(argv[++i]);
+			}
+			else if (strcmp(argv[i], "--fps-limit") == 0) {
+				fpsLimit = atof(argv[++i]);
+			}
+			else if (strcmp(argv[i], "--max-frames-in-flight") == 0) {
+				maxFramesInFlight = (unsigned int)strtoul(argv[++i], NULL, 10);
+			}
+			else if (strcmp(argv[i], "--latency-log") == 0) {
+				latencyPath = argv[++i];
+			}
+		}
+	}
+
+	//Applies the swap interval to the current context, window is NULL when headless (nothing to sync to)
+	void init(GLFWwindow* window) {
+		if (window != NULL) {
+			int interval = swapInterval;
+			if (interval < 0 && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+				std::cout << "ERROR::FRAME_PACER::ADAPTIVE_VSYNC_NOT_SUPPORTED\nUsing swap interval 1" << std::endl;
+				interval = 1;
+			}
+			glfwSwapInterval(interval);
+		}
+		nextDeadline = Clock::now();
+		frameStart();
+	}
+
+	//Call right after polling input, the frame's latency is measured from here
+	void frameStart() {
+		inputTime = Clock::now();
+	}
+
+	//Call right after the frame was presented
+	void frameSubmitted() {
+		InFlightFrame inFlight = { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), inputTime };
+		if (inFlight.fence != NULL) {
+			inFlightFrames.push_back(inFlight);
+		}
+	}
+
+	//Call before polling input for the next frame. Blocks until starting one keeps within the frames in flight
+	//cap and the frame rate limit
+	void throttle() {
+		//Collect whatever finished on its own
+		while (!inFlightFrames.empty() && glClientWaitSync(inFlightFrames.front().fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+			retire();
+		}
+		if (maxFramesInFlight > 0) {
+			while (inFlightFrames.size() >= maxFramesInFlight) {
+				Clock::time_point start = Clock::now();
+				GLenum result = glClientWaitSync(inFlightFrames.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+				fenceWaitMs += milliseconds(start, Clock::now());
+				if (result == GL_WAIT_FAILED || result == GL_TIMEOUT_EXPIRED) {
+					std::cout << "ERROR::FRAME_PACER::FENCE_WAIT_FAILED" << std::endl;
+				}
+				retire();
+			}
+		}
+		if (fpsLimit > 0.0) {
+			limit();
+		}
+	}
+
+	//Deletes the fences still pending and writes --latency-log, call while the context is current
+	void destroy() {
+		for (const InFlightFrame& inFlight : inFlightFrames) {
+			glDeleteSync(inFlight.fence);
+		}
+		inFlightFrames.clear();
+		if (!latencyPath.empty()) {
+			writeLatencyLog(latencyPath.c_str());
+		}
+	}
+
+	void printStats() const {
+		if (latencies.empty()) {
+			return;
+		}
+		std::vector<double> sorted(latencies);
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (double latency : sorted) {
+			total += latency;
+		}
+		std::cout << "FRAME_PACER: latency " << total / sorted.size() << " ms avg, " << sorted[sorted.size() / 2]
+			<< " ms median, " << sorted.back() << " ms max over " << sorted.size() << " frames, waited "
+			<< fenceWaitMs << " ms on fences and " << limiterWaitMs << " ms in the limiter" << std::endl;
+	}
+
+	bool writeLatencyLog(const char* path) const {
+		std::ofstream file(path);
+		if (!file) {
+			std::cout << "ERROR::FRAME_PACER::LATENCY_LOG_FAILED\n" << path << std::endl;
+			return false;
+		}
+		file << "frame,latency_ms\n";
+		for (size_t i = 0; i < latencies.size(); i++) {
+			file << i << "," << latencies[i] << "\n";
+		}
+		return true;
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct InFlightFrame {
+		GLsync fence;
+		Clock::time_point inputTime;
+	};
+
+	std::deque<InFlightFrame> inFlightFrames;
+	//Milliseconds, in frame order (fences signal in order)
+	std::vector<double> latencies;
+	Clock::time_point inputTime;
+	Clock::time_point nextDeadline;
+	std::string latencyPath;
+
+	static double milliseconds(Clock::time_point from, Clock::time_point to) {
+		return std::chrono::duration<double, std::milli>(to - from).count();
+	}
+
+	void retire() {
+		InFlightFrame& inFlight = inFlightFrames.front();
+		latencies.push_back(milliseconds(inFlight.inputTime, Clock::now()));
+		glDeleteSync(inFlight.fence);
+		inFlightFrames.pop_front();
+	}
+
+	void limit() {
+		Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fpsLimit));
+		Clock::time_point start = Clock::now();
+		nextDeadline += period;
+		//More than a frame late (a hitch, a breakpoint), start over instead of rushing frames to catch up
+		if (nextDeadline + period < start) {
+			nextDeadline = start;
+			return;
+		}
+		Clock::duration spin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(spinSeconds));
+		if (nextDeadline - start > spin) {
+			std::this_thread::sleep_for(nextDeadline - start - spin);
+		}
+		while (Clock::now() < nextDeadline) {
+			std::this_thread::yield();
+		}
+		limiterWaitMs += milliseconds(start, Clock::now());
+	}
+};
+
+#endif // !FRAMEPACER_H
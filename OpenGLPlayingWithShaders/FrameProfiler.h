@@ -0,0 +1,303 @@
+#ifndef FRAMEPROFILER_H
+
+#define FRAMEPROFILER_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+
+//Per-frame CPU and GPU timings split into named zones.
+//CPU zones use a steady clock. GPU zones put a glQueryCounter timestamp before and after their commands
+//(timestamps nest, GL_TIME_ELAPSED queries don't) and are read back FRAME_LATENCY frames later, by which
+//time the GPU is normally done with them, so reading them never stalls the pipeline.
+//Everything is accumulated into per-zone averages for printStats() and, up to maxTraceEvents, kept as
+//events that writeChromeTrace() saves for chrome://tracing or ui.perfetto.dev.
+//Zone names must outlive the profiler (string literals).
+class FrameProfiler {
+public:
+	//Zones are no-ops while false, so the zones can stay in release builds
+	bool enabled = true;
+	//Events kept for the trace, later ones are dropped once it is full
+	size_t maxTraceEvents = 1 << 20;
+	//Times a GPU result still wasn't ready FRAME_LATENCY frames later and we had to wait for it
+	unsigned int gpuStalls = 0;
+
+	FrameProfiler() {
+		startTime = std::chrono::steady_clock::now();
+	}
+
+	//Reads --trace file.json, written by writeChromeTrace() with no arguments
+	void parseArguments(int argc, char** argv) {
+		for (int i = 1; i + 1 < argc; i++) {
+			if (strcmp(argv[i], "--trace") == 0) {
+				tracePath = argv[i + 1];
+			}
+		}
+	}
+
+	//Call at the start of the frame, opens a "Frame" zone on both timelines
+	void beginFrame() {
+		if (!enabled) {
+			return;
+		}
+		if (!gpuClockKnown) {
+			//Line the GPU timeline up with the CPU one, good to a few microseconds
+			GLint64 gpuNow = 0;
+			glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+			gpuOffset = now() - gpuNow / 1000.0;
+			gpuClockKnown = true;
+		}
+		resolve(frames[frame % FRAME_LATENCY]);
+		frameCpuZone = beginCpu("Frame");
+		frameGpuZone = beginGpu("Frame");
+	}
+
+	void endFrame() {
+		if (!enabled) {
+			return;
+		}
+		endGpu(frameGpuZone);
+		endCpu(frameCpuZone);
+		frame++;
+	}
+
+	//Returns the zone to pass to endCpu(), prefer CpuZone over calling these directly
+	int beginCpu(const char* name) {
+		if (!enabled) {
+			return -1;
+		}
+		openCpu.push_back(OpenCpuZone{ name, now() });
+		return (int)openCpu.size() - 1;
+	}
+
+	void endCpu(int zone) {
+		if (zone < 0) {
+			return;
+		}
+		double end = now();
+		OpenCpuZone open = openCpu[zone];
+		openCpu.resize(zone);
+		record(open.name, CPU_THREAD, open.start, end - open.start);
+	}
+
+	//Returns the zone to pass to endGpu(), prefer GpuZone over calling these directly
+	int beginGpu(const char* name) {
+		if (!enabled) {
+			return -1;
+		}
+		FrameQueries& slot = frames[frame % FRAME_LATENCY];
+		GpuQuery query = { name, { takeQuery(), takeQuery() } };
+		glQueryCounter(query.queries[0], GL_TIMESTAMP);
+		slot.zones.push_back(query);
+		return (int)slot.zones.size() - 1;
+	}
+
+	void endGpu(int zone) {
+		if (zone < 0) {
+			return;
+		}
+		glQueryCounter(frames[frame % FRAME_LATENCY].zones[zone].queries[1], GL_TIMESTAMP);
+	}
+
+	void printStats() const {
+		std::cout << "FRAME_PROFILER: " << frame << " frames, " << gpuStalls << " GPU stalls" << std::endl;
+		for (const ZoneStats& zone : stats) {
+			if (zone.count == 0) {
+				continue;
+			}
+			std::cout << "  " << (zone.thread == CPU_THREAD ? "CPU " : "GPU ") << zone.name << ": "
+				<< zone.total / zone.count / 1000.0 << " ms avg, " << zone.max / 1000.0 << " ms max, "
+				<< zone.count << " calls" << std::endl;
+		}
+	}
+
+	//Writes the events in the Chrome trace event format, CPU and GPU zones as two threads
+	bool writeChromeTrace(const char* path) const {
+		FILE* file = fopen(path, "wb");
+		if (file == NULL) {
+			std::cout << "ERROR::FRAME_PROFILER::TRACE_NOT_WRITTEN\n" << path << std::endl;
+			return false;
+		}
+		fprintf(file, "{\"traceEvents\":[\n");
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"CPU\"}},\n", CPU_THREAD);
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU\"}}", GPU_THREAD);
+		for (const TraceEvent& event : events) {
+			fprintf(file, ",\n{\"name\":\"");
+			//Names are literals, but keep the JSON valid whatever they contain
+			for (const char* c = event.name; *c != '\0'; c++) {
+				if (*c == '"' || *c == '\\') {
+					fputc('\\', file);
+				}
+				fputc((unsigned char)*c < 0x20 ? ' ' : *c, file);
+			}
+			fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", event.thread, event.start, event.duration);
+		}
+		fprintf(file, "\n]}\n");
+		fclose(file);
+		return true;
+	}
+
+	//Writes to the --trace path, if one was given
+	bool writeChromeTrace() const {
+		return tracePath.empty() || writeChromeTrace(tracePath.c_str());
+	}
+
+	//Frees the query objects, call before the context goes away
+	void destroy() {
+		//The last frames are still in flight, wait for them here instead of counting them as stalls
+		glFinish();
+		for (int i = 0; i < FRAME_LATENCY; i++) {
+			resolve(frames[i]);
+		}
+		if (!freeQueries.empty()) {
+			glDeleteQueries((GLsizei)freeQueries.size(), freeQueries.data());
+			freeQueries.clear();
+		}
+	}
+
+private:
+	static const int FRAME_LATENCY = 4;
+	static const int CPU_THREAD = 1;
+	static const int GPU_THREAD = 2;
+
+	struct OpenCpuZone {
+		const char* name;
+		double start;
+	};
+	struct GpuQuery {
+		const char* name;
+		unsigned int queries[2];
+	};
+	struct FrameQueries {
+		std::vector<GpuQuery> zones;
+	};
+	struct ZoneStats {
+		const char* name;
+		int thread;
+		unsigned int count;
+		//Microseconds
+		double total;
+		double max;
+	};
+	struct TraceEvent {
+		const char* name;
+		int thread;
+		//Microseconds since the profiler was created
+		double start;
+		double duration;
+	};
+
+	std::chrono::steady_clock::time_point startTime;
+	std::string tracePath;
+	unsigned int frame = 0;
+	int frameCpuZone = -1;
+	int frameGpuZone = -1;
+	std::vector<OpenCpuZone> openCpu;
+	FrameQueries frames[FRAME_LATENCY];
+	std::vector<unsigned int> freeQueries;
+	bool gpuClockKnown = false;
+	//Added to GPU timestamps (in microseconds) to put them on the CPU timeline
+	double gpuOffset = 0.0;
+	std::vector<ZoneStats> stats;
+	std::vector<TraceEvent> events;
+
+	//Microseconds since the profiler was created
+	double now() const {
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	unsigned int takeQuery() {
+		if (freeQueries.empty()) {
+			unsigned int query;
+			glGenQueries(1, &query);
+			return query;
+		}
+		unsigned int query = freeQueries.back();
+		freeQueries.pop_back();
+		return query;
+	}
+
+	//Reads back the GPU zones of an old frame and recycles their queries
+	void resolve(FrameQueries& slot) {
+		if (slot.zones.empty()) {
+			return;
+		}
+		for (const GpuQuery& zone : slot.zones) {
+			int available = 0;
+			glGetQueryObjectiv(zone.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				gpuStalls++;
+				break;
+			}
+		}
+		for (const GpuQuery& zone : slot.zones) {
+			GLuint64 start = 0, end = 0;
+			glGetQueryObjectui64v(zone.queries[0], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(zone.queries[1], GL_QUERY_RESULT, &end);
+			record(zone.name, GPU_THREAD, start / 1000.0 + gpuOffset, (end - start) / 1000.0);
+			freeQueries.push_back(zone.queries[0]);
+			freeQueries.push_back(zone.queries[1]);
+		}
+		slot.zones.clear();
+	}
+
+	void record(const char* name, int thread, double start, double duration) {
+		ZoneStats* zone = NULL;
+		for (ZoneStats& candidate : stats) {
+			if (candidate.thread == thread && (candidate.name == name || strcmp(candidate.name, name) == 0)) {
+				zone = &candidate;
+				break;
+			}
+		}
+		if (zone == NULL) {
+			stats.push_back(ZoneStats{ name, thread, 0, 0.0, 0.0 });
+			zone = &stats.back();
+		}
+		zone->count++;
+		zone->total += duration;
+		if (duration > zone->max) {
+			zone->max = duration;
+		}
+		if (events.size() < maxTraceEvents) {
+			events.push_back(TraceEvent{ name, thread, start, duration });
+		}
+	}
+};
+
+//Times the enclosing scope on the CPU timeline
+class CpuZone {
+public:
+	CpuZone(FrameProfiler& profiler, const char* name) : profiler(profiler), zone(profiler.beginCpu(name)) {}
+	~CpuZone() {
+		profiler.endCpu(zone);
+	}
+	CpuZone(const CpuZone&) = delete;
+	CpuZone& operator=(const CpuZone&) = delete;
+
+private:
+	FrameProfiler& profiler;
+	int zone;
+};
+
+//Times the GL commands issued in the enclosing scope on the GPU timeline
+class GpuZone {
+public:
+	GpuZone(FrameProfiler& profiler, const char* name) : profiler(profiler), zone(profiler.beginGpu(name)) {}
+	~GpuZone() {
+		profiler.endGpu(zone);
+	}
+	GpuZone(const GpuZone&) = delete;
+	GpuZone& operator=(const GpuZone&) = delete;
+
+private:
+	FrameProfiler& profiler;
+	int zone;
+};
+
+#endif // !FRAMEPROFILER_H
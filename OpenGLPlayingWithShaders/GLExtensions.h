@@ -0,0 +1,29 @@
+#ifndef GLEXTENSIONS_H
+
+#define GLEXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+//Core profile contexts can't use glGetString(GL_EXTENSIONS), so walk the indexed list instead
+inline bool hasGLExtension(const char* name) {
+	int count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (int i = 0; i < count; i++) {
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+		if (extension != NULL && strcmp(extension, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+inline bool hasGLVersion(int major, int minor) {
+	int contextMajor = 0, contextMinor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+	glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+	return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+#endif // !GLEXTENSIONS_H
@@ -0,0 +1,116 @@
+#ifndef GLHANDLES_H
+
+#define GLHANDLES_H
+
+#include <glad/glad.h>
+#include "GLStateCache.h"
+
+enum class GLObjectType {
+	Buffer,
+	VertexArray,
+	Program
+};
+
+//Owns one GL object name: the object is deleted when the handle goes away, handles can be moved but not copied.
+//GL unbinds a buffer or vertex array when it is deleted, so those also tell the GLStateCache they were
+//created with, otherwise a recycled name could be skipped as "already bound".
+//Handles must be destroyed while the context is still current, see Renderer for the ordering.
+template <GLObjectType Type>
+class GLHandle {
+public:
+	GLHandle() {}
+
+	~GLHandle() {
+		reset();
+	}
+
+	GLHandle(GLHandle&& other) noexcept : id(other.id), state(other.state) {
+		other.id = 0;
+	}
+
+	GLHandle& operator=(GLHandle&& other) noexcept {
+		if (this != &other) {
+			reset();
+			id = other.id;
+			state = other.state;
+			other.id = 0;
+		}
+		return *this;
+	}
+
+	GLHandle(const GLHandle&) = delete;
+	GLHandle& operator=(const GLHandle&) = delete;
+
+	static GLHandle create(GLStateCache* state = NULL) {
+		GLHandle handle;
+		handle.state = state;
+		switch (Type) {
+		case GLObjectType::Buffer:
+			glGenBuffers(1, &handle.id);
+			break;
+		case GLObjectType::VertexArray:
+			glGenVertexArrays(1, &handle.id);
+			break;
+		case GLObjectType::Program:
+			handle.id = glCreateProgram();
+			break;
+		}
+		return handle;
+	}
+
+	//Takes ownership of a name created somewhere else
+	static GLHandle adopt(unsigned int id, GLStateCache* state = NULL) {
+		GLHandle handle;
+		handle.id = id;
+		handle.state = state;
+		return handle;
+	}
+
+	unsigned int get() const {
+		return id;
+	}
+
+	//Gives up ownership without deleting
+	unsigned int release() {
+		unsigned int released = id;
+		id = 0;
+		return released;
+	}
+
+	void reset() {
+		if (id == 0) {
+			return;
+		}
+		switch (Type) {
+		case GLObjectType::Buffer:
+			glDeleteBuffers(1, &id);
+			if (state != NULL) {
+				state->onDeleteBuffer(id);
+			}
+			break;
+		case GLObjectType::VertexArray:
+			glDeleteVertexArrays(1, &id);
+			if (state != NULL) {
+				state->onDeleteVertexArray(id);
+			}
+			break;
+		case GLObjectType::Program:
+			glDeleteProgram(id);
+			if (state != NULL) {
+				state->onDeleteProgram(id);
+			}
+			break;
+		}
+		id = 0;
+	}
+
+private:
+	unsigned int id = 0;
+	GLStateCache* state = NULL;
+};
+
+typedef GLHandle<GLObjectType::Buffer> BufferHandle;
+typedef GLHandle<GLObjectType::VertexArray> VertexArrayHandle;
+typedef GLHandle<GLObjectType::Program> ProgramHandle;
+
+#endif // !GLHANDLES_H
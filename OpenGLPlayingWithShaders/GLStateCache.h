@@ -0,0 +1,165 @@
+#ifndef GLSTATECACHE_H
+
+#define GLSTATECACHE_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+//Shadow copy of the GL binding state we touch every frame.
+//Each setter compares against what we last told GL and skips the call if nothing would change.
+//Everything starts out unknown, so the first call always goes through. If some code changes this
+//state behind the cache's back, call invalidate() afterwards.
+class GLStateCache {
+public:
+	//Calls that reached the driver
+	unsigned int issuedCalls = 0;
+	//Calls skipped because the state was already set
+	unsigned int elidedCalls = 0;
+
+	GLStateCache() {
+		invalidate();
+	}
+
+	void invalidate() {
+		program = UNKNOWN;
+		vertexArray = UNKNOWN;
+		for (int i = 0; i < BUFFER_TARGET_COUNT; i++) {
+			buffers[i] = UNKNOWN;
+		}
+		clearColorKnown = false;
+		viewportKnown = false;
+	}
+
+	void resetCounters() {
+		issuedCalls = 0;
+		elidedCalls = 0;
+	}
+
+	void useProgram(unsigned int newProgram) {
+		if (check(program == newProgram)) {
+			return;
+		}
+		program = newProgram;
+		glUseProgram(newProgram);
+	}
+
+	void bindVertexArray(unsigned int newVertexArray) {
+		if (check(vertexArray == newVertexArray)) {
+			return;
+		}
+		vertexArray = newVertexArray;
+		//The element buffer binding is part of the VAO, so whatever is bound now is unknown to us
+		buffers[targetIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+		glBindVertexArray(newVertexArray);
+	}
+
+	void bindBuffer(GLenum target, unsigned int buffer) {
+		int index = targetIndex(target);
+		if (index < 0) {
+			//Not a target we shadow, always forward it
+			issuedCalls++;
+			glBindBuffer(target, buffer);
+			return;
+		}
+		if (check(buffers[index] == buffer)) {
+			return;
+		}
+		buffers[index] = buffer;
+		glBindBuffer(target, buffer);
+	}
+
+	void clearColor(float r, float g, float b, float a) {
+		if (check(clearColorKnown && color[0] == r && color[1] == g && color[2] == b && color[3] == a)) {
+			return;
+		}
+		color[0] = r;
+		color[1] = g;
+		color[2] = b;
+		color[3] = a;
+		clearColorKnown = true;
+		glClearColor(r, g, b, a);
+	}
+
+	void viewport(int x, int y, int width, int height) {
+		if (check(viewportKnown && view[0] == x && view[1] == y && view[2] == width && view[3] == height)) {
+			return;
+		}
+		view[0] = x;
+		view[1] = y;
+		view[2] = width;
+		view[3] = height;
+		viewportKnown = true;
+		glViewport(x, y, width, height);
+	}
+
+	//GL resets a binding to 0 when the bound object is deleted, call these so the cache does the same
+	void onDeleteProgram(unsigned int deleted) {
+		//A deleted program stays in use until another one is made current, so only forget the name
+		if (program == deleted) {
+			program = UNKNOWN;
+		}
+	}
+	void onDeleteVertexArray(unsigned int deleted) {
+		if (vertexArray == deleted) {
+			vertexArray = 0;
+			buffers[targetIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+		}
+	}
+	void onDeleteBuffer(unsigned int deleted) {
+		for (int i = 0; i < BUFFER_TARGET_COUNT; i++) {
+			if (buffers[i] == deleted) {
+				buffers[i] = 0;
+			}
+		}
+	}
+
+	unsigned int currentProgram() const {
+		return program;
+	}
+
+	void printStats() const {
+		unsigned int total = issuedCalls + elidedCalls;
+		std::cout << "GL_STATE_CACHE: " << issuedCalls << " issued, " << elidedCalls << " elided ("
+			<< (total > 0 ? elidedCalls * 100 / total : 0) << "%)" << std::endl;
+	}
+
+private:
+	static const unsigned int UNKNOWN = 0xFFFFFFFF;
+	static const int BUFFER_TARGET_COUNT = 8;
+
+	unsigned int program;
+	unsigned int vertexArray;
+	unsigned int buffers[BUFFER_TARGET_COUNT];
+	float color[4];
+	bool clearColorKnown;
+	int view[4];
+	bool viewportKnown;
+
+	//Counts the call either way, returns true if it can be skipped
+	bool check(bool redundant) {
+		if (redundant) {
+			elidedCalls++;
+		}
+		else {
+			issuedCalls++;
+		}
+		return redundant;
+	}
+
+	static int targetIndex(GLenum target) {
+		switch (target) {
+		case GL_ARRAY_BUFFER: return 0;
+		case GL_ELEMENT_ARRAY_BUFFER: return 1;
+		case GL_UNIFORM_BUFFER: return 2;
+		case GL_COPY_READ_BUFFER: return 3;
+		case GL_COPY_WRITE_BUFFER: return 4;
+		case GL_PIXEL_PACK_BUFFER: return 5;
+		case GL_PIXEL_UNPACK_BUFFER: return 6;
+		case GL_TEXTURE_BUFFER: return 7;
+		default: return -1;
+		}
+	}
+};
+
+#endif // !GLSTATECACHE_H
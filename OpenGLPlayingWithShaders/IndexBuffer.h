@@ -0,0 +1,185 @@
+#ifndef INDEXBUFFER_H
+
+#define INDEXBUFFER_H
+
+#include <glad/glad.h>
+#include "GLStateCache.h"
+#include "DrawCommand.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+//Collects the 32-bit indices of one or more meshes and uploads them as the smallest index type they fit, half
+//(or a quarter) of the memory and index fetch bandwidth of GL_UNSIGNED_INT.
+//Each mesh's indices are rebased to the lowest vertex they use, which goes into its base vertex instead, so what
+//counts is how many vertices a mesh spans, not where it sits in a shared vertex buffer. A mesh spanning more than
+//65536 vertices is split into chunks that each span fewer, drawn together with one glMultiDrawElementsBaseVertex.
+//Splitting only pays off when the chunks are big, i.e. when the triangles are ordered by the vertices they use
+//(MeshOptimizer::optimizeVertexFetch does that). If they aren't, the buffer stays 32-bit.
+class IndexBuffer {
+public:
+	//Fewest triangles per chunk, on average, for splitting to be worth the extra draws
+	static const unsigned int MIN_CHUNK_TRIANGLES = 1024;
+
+	//Smallest type upload() may pick. GL_UNSIGNED_BYTE saves another half on meshes of up to 256 vertices, but not
+	//every GPU reads bytes natively and some drivers widen them at draw time, so it has to be asked for
+	GLenum smallestType = GL_UNSIGNED_SHORT;
+
+	//Triangle list indices local to the mesh, baseVertex is where vertex 0 of the mesh lives. Returns the mesh id
+	unsigned int addMesh(const unsigned int* indices, size_t count, GLint baseVertex) {
+		Entry entry = { source.size(), count, baseVertex, 0, 0 };
+		source.insert(source.end(), indices, indices + count);
+		meshes.push_back(entry);
+		return (unsigned int)meshes.size() - 1;
+	}
+
+	//Picks the type, splits what has to be split and uploads to buffer through the bound VAO. The CPU copies are
+	//released afterwards, the chunks stay for drawing
+	void upload(GLStateCache& state, unsigned int buffer) {
+		type = GL_UNSIGNED_INT;
+		if (smallestType == GL_UNSIGNED_BYTE && split(0xFF, false)) {
+			type = GL_UNSIGNED_BYTE;
+		}
+		else if (smallestType != GL_UNSIGNED_INT && split(0xFFFF, true)) {
+			type = GL_UNSIGNED_SHORT;
+		}
+		else {
+			split(0xFFFFFFFFu, false);
+		}
+
+		std::vector<unsigned char> packed(source.size() * indexTypeSize(type));
+		for (const Entry& mesh : meshes) {
+			for (unsigned int c = mesh.firstChunk; c < mesh.firstChunk + mesh.chunkCount; c++) {
+				const MeshChunk& chunk = chunks[c];
+				unsigned int lowest = (unsigned int)(chunk.baseVertex - mesh.baseVertex);
+				pack(&source[chunk.first], chunk.count, lowest, packed.data() + (size_t)chunk.first * indexTypeSize(type));
+			}
+		}
+		state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)packed.size(), packed.data(), GL_STATIC_DRAW);
+		uploadedBytes = packed.size();
+		std::vector<unsigned int>().swap(source);
+	}
+
+	//Valid after upload()
+	GLenum getType() const {
+		return type;
+	}
+
+	size_t getUploadedBytes() const {
+		return uploadedBytes;
+	}
+
+	//A Mesh for draws of mesh, with the first chunk's range when there is only one
+	Mesh getMesh(unsigned int vertexArray, unsigned int mesh) const {
+		const Entry& entry = meshes[mesh];
+		const MeshChunk& first = chunks[entry.firstChunk];
+		Mesh result = { vertexArray, (GLsizei)entry.count, first.first, first.baseVertex, true, type, NULL, 0 };
+		if (entry.chunkCount > 1) {
+			result.chunks = &chunks[entry.firstChunk];
+			result.chunkCount = entry.chunkCount;
+		}
+		return result;
+	}
+
+	const MeshChunk* getChunks(unsigned int mesh) const {
+		return &chunks[meshes[mesh].firstChunk];
+	}
+
+	unsigned int getChunkCount(unsigned int mesh) const {
+		return meshes[mesh].chunkCount;
+	}
+
+	unsigned int meshCount() const {
+		return (unsigned int)meshes.size();
+	}
+
+private:
+	struct Entry {
+		size_t first;
+		size_t count;
+		GLint baseVertex;
+		unsigned int firstChunk;
+		unsigned int chunkCount;
+	};
+
+	std::vector<unsigned int> source;
+	std::vector<Entry> meshes;
+	std::vector<MeshChunk> chunks;
+	GLenum type = GL_UNSIGNED_INT;
+	size_t uploadedBytes = 0;
+
+	//Cuts every mesh, triangle by triangle, into chunks spanning at most maxRange + 1 vertices. Fails if a mesh needs
+	//more than one chunk and splitting isn't allowed or doesn't pay off
+	bool split(unsigned int maxRange, bool allowSplitting) {
+		chunks.clear();
+		for (Entry& mesh : meshes) {
+			mesh.firstChunk = (unsigned int)chunks.size();
+			size_t begin = mesh.first;
+			size_t end = mesh.first + mesh.count;
+			size_t chunkStart = begin;
+			unsigned int lowest = 0xFFFFFFFFu;
+			unsigned int highest = 0;
+			size_t i = begin;
+			while (i < end) {
+				unsigned int triangleLowest = lowest;
+				unsigned int triangleHighest = highest;
+				for (size_t c = i; c < i + 3 && c < end; c++) {
+					triangleLowest = source[c] < triangleLowest ? source[c] : triangleLowest;
+					triangleHighest = source[c] > triangleHighest ? source[c] : triangleHighest;
+				}
+				if (triangleHighest - triangleLowest > maxRange) {
+					if (i == chunkStart) {
+						//A single triangle spans too much
+						return false;
+					}
+					//Close the chunk before this triangle and try it again in a new one
+					addChunk(mesh, chunkStart, i, lowest);
+					chunkStart = i;
+					lowest = 0xFFFFFFFFu;
+					highest = 0;
+					continue;
+				}
+				lowest = triangleLowest;
+				highest = triangleHighest;
+				i += 3;
+			}
+			addChunk(mesh, chunkStart, end, mesh.count > 0 ? lowest : 0);
+			mesh.chunkCount = (unsigned int)chunks.size() - mesh.firstChunk;
+			if (mesh.chunkCount > 1 && (!allowSplitting || mesh.count / 3 / mesh.chunkCount < MIN_CHUNK_TRIANGLES)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void addChunk(const Entry& mesh, size_t begin, size_t end, unsigned int lowest) {
+		MeshChunk chunk = { (unsigned int)begin, (GLsizei)(end - begin), mesh.baseVertex + (GLint)lowest };
+		chunks.push_back(chunk);
+	}
+
+	void pack(const unsigned int* indices, size_t count, unsigned int lowest, unsigned char* out) const {
+		switch (type) {
+		case GL_UNSIGNED_BYTE:
+			for (size_t i = 0; i < count; i++) {
+				out[i] = (unsigned char)(indices[i] - lowest);
+			}
+			break;
+		case GL_UNSIGNED_SHORT:
+			for (size_t i = 0; i < count; i++) {
+				uint16_t value = (uint16_t)(indices[i] - lowest);
+				memcpy(out + i * 2, &value, 2);
+			}
+			break;
+		default:
+			for (size_t i = 0; i < count; i++) {
+				uint32_t value = indices[i] - lowest;
+				memcpy(out + i * 4, &value, 4);
+			}
+			break;
+		}
+	}
+};
+
+#endif // !INDEXBUFFER_H
@@ -0,0 +1,186 @@
+#ifndef INSTANCEDMESH_H
+
+#define INSTANCEDMESH_H
+
+#include <glad/glad.h>
+#include "GLStateCache.h"
+#include "GLHandles.h"
+#include "VertexLayout.h"
+#include "IndexBuffer.h"
+
+#include <vector>
+#include <cstdint>
+
+//Per-instance data most 2D sprites need, matches two vec4 attributes in the vertex shader
+struct SpriteInstance {
+	//xy = offset, zw = scale
+	float transform[4];
+	float color[4];
+};
+
+typedef VertexLayout<Attr<1, 4>, Attr<2, 4>> SpriteInstanceLayout;
+static_assert(SpriteInstanceLayout::stride == sizeof(SpriteInstance), "SpriteInstanceLayout doesn't match SpriteInstance");
+
+//One mesh uploaded once and drawn any number of times with a single instanced draw call.
+//Per-vertex attributes come from the mesh VBO, per-instance attributes from a second VBO with a
+//divisor of 1, so drawing n copies costs one call no matter how big n gets.
+class InstancedMesh {
+public:
+	VertexArrayHandle VAO;
+	BufferHandle VBO;
+	BufferHandle EBO;
+	BufferHandle instanceVBO;
+
+	InstancedMesh(unsigned int vertexStride, unsigned int instanceStride) : vertexStride(vertexStride), instanceStride(instanceStride) {}
+
+	//Same arguments as glVertexAttribPointer, offset is in bytes inside one vertex
+	void addAttribute(unsigned int index, int size, GLenum type, bool normalized, unsigned int offset) {
+		attributes.push_back(Attribute{ index, size, type, normalized, offset, false });
+	}
+
+	//Same, but advances once per instance instead of once per vertex
+	void addInstanceAttribute(unsigned int index, int size, GLenum type, bool normalized, unsigned int offset) {
+		attributes.push_back(Attribute{ index, size, type, normalized, offset, true });
+	}
+
+	//From VertexFormat::getAttributes() or VertexLayout::getAttributes()
+	void addAttributes(const std::vector<VertexAttribute>& layout) {
+		for (const VertexAttribute& attribute : layout) {
+			addAttribute(attribute.index, attribute.size, attribute.type, attribute.normalized, attribute.offset);
+		}
+	}
+
+	void addInstanceAttributes(const std::vector<VertexAttribute>& layout) {
+		for (const VertexAttribute& attribute : layout) {
+			addInstanceAttribute(attribute.index, attribute.size, attribute.type, attribute.normalized, attribute.offset);
+		}
+	}
+
+	//indices may be NULL to draw the vertices as a plain triangle list
+	void upload(GLStateCache& state, const void* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount) {
+		VAO = VertexArrayHandle::create(&state);
+		VBO = BufferHandle::create(&state);
+		instanceVBO = BufferHandle::create(&state);
+		state.bindVertexArray(VAO.get());
+
+		state.bindBuffer(GL_ARRAY_BUFFER, VBO.get());
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCount * vertexStride, vertices, GL_STATIC_DRAW);
+		for (const Attribute& attribute : attributes) {
+			if (!attribute.perInstance) {
+				setPointer(attribute, vertexStride);
+			}
+		}
+
+		state.bindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+		for (const Attribute& attribute : attributes) {
+			if (attribute.perInstance) {
+				setPointer(attribute, instanceStride);
+				glVertexAttribDivisor(attribute.index, 1);
+			}
+		}
+
+		if (indices != NULL) {
+			EBO = BufferHandle::create(&state);
+			indexData.addMesh(indices, indexCount, 0);
+			indexData.upload(state, EBO.get());
+			count = (GLsizei)indexCount;
+		}
+		else {
+			count = (GLsizei)vertexCount;
+		}
+		state.bindVertexArray(0);
+	}
+
+	//Replaces every instance, call it whenever the instance data changes (or every frame)
+	void setInstances(GLStateCache& state, const void* instances, unsigned int instanceCount) {
+		state.bindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+		GLsizeiptr size = (GLsizeiptr)instanceCount * instanceStride;
+		if (size > capacity) {
+			glBufferData(GL_ARRAY_BUFFER, size, instances, GL_DYNAMIC_DRAW);
+			capacity = size;
+		}
+		else {
+			//Orphan the old storage first so we never wait on a draw that is still reading it
+			glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_DYNAMIC_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances);
+		}
+		this->instanceCount = (GLsizei)instanceCount;
+	}
+
+	//Draws instances that live in another buffer, e.g. this frame's slice of a StreamBuffer.
+	//The per-instance attributes are pointed at buffer + offset, so nothing is copied
+	void drawFromBuffer(GLStateCache& state, unsigned int buffer, GLintptr offset, unsigned int instanceCount) {
+		if (instanceCount == 0) {
+			return;
+		}
+		state.bindVertexArray(VAO.get());
+		state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+		for (const Attribute& attribute : attributes) {
+			if (attribute.perInstance) {
+				Attribute moved = attribute;
+				moved.offset += (unsigned int)offset;
+				setPointer(moved, instanceStride);
+			}
+		}
+		submit((GLsizei)instanceCount);
+		//The VAO now reads instances from buffer, draw() has to point it back first
+		streaming = true;
+	}
+
+	void draw(GLStateCache& state) {
+		if (instanceCount == 0) {
+			return;
+		}
+		state.bindVertexArray(VAO.get());
+		if (streaming) {
+			state.bindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+			for (const Attribute& attribute : attributes) {
+				if (attribute.perInstance) {
+					setPointer(attribute, instanceStride);
+				}
+			}
+			streaming = false;
+		}
+		submit(instanceCount);
+	}
+
+private:
+	struct Attribute {
+		unsigned int index;
+		int size;
+		GLenum type;
+		bool normalized;
+		unsigned int offset;
+		bool perInstance;
+	};
+
+	unsigned int vertexStride;
+	unsigned int instanceStride;
+	std::vector<Attribute> attributes;
+	IndexBuffer indexData;
+	GLsizei count = 0;
+	GLsizei instanceCount = 0;
+	GLsizeiptr capacity = 0;
+	bool streaming = false;
+
+	//One instanced draw per index chunk, usually just one
+	void submit(GLsizei instances) const {
+		if (EBO.get() == 0) {
+			glDrawArraysInstanced(GL_TRIANGLES, 0, count, instances);
+			return;
+		}
+		const MeshChunk* chunks = indexData.getChunks(0);
+		for (unsigned int c = 0; c < indexData.getChunkCount(0); c++) {
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, chunks[c].count, indexData.getType(),
+				(void*)(uintptr_t)(chunks[c].first * indexTypeSize(indexData.getType())), instances, chunks[c].baseVertex);
+		}
+	}
+
+	static void setPointer(const Attribute& attribute, unsigned int stride) {
+		glVertexAttribPointer(attribute.index, attribute.size, attribute.type, attribute.normalized ? GL_TRUE : GL_FALSE,
+			(GLsizei)stride, (void*)(uintptr_t)attribute.offset);
+		glEnableVertexAttribArray(attribute.index);
+	}
+};
+
+#endif // !INSTANCEDMESH_H
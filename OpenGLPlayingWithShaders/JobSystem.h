@@ -0,0 +1,177 @@
+#ifndef JOBSYSTEM_H
+
+#define JOBSYSTEM_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+
+//A pool of worker threads that split loops between them. Every thread, the caller included, has its own
+//job deque: a thread takes work from the back of its own deque and, once it is empty, steals from the front
+//of the others, so a thread that gets cheap chunks keeps helping the ones that got expensive chunks.
+//Jobs must not touch GL, the context is only current on the thread that created it.
+//parallelFor is meant to be called from one thread at a time and not from inside a job.
+class JobSystem {
+public:
+	JobSystem() {}
+	~JobSystem() {
+		shutdown();
+	}
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	//threadCount includes the calling thread, 0 uses every hardware thread, 1 runs everything inline
+	void init(unsigned int threadCount = 0) {
+		shutdown();
+		if (threadCount == 0) {
+			threadCount = std::thread::hardware_concurrency();
+			if (threadCount == 0) {
+				threadCount = 1;
+			}
+		}
+		for (unsigned int i = 0; i < threadCount; i++) {
+			queues.emplace_back(new JobQueue());
+		}
+		running = true;
+		for (unsigned int i = 1; i < threadCount; i++) {
+			threads.emplace_back(&JobSystem::workerLoop, this, i);
+		}
+	}
+
+	void shutdown() {
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			running = false;
+		}
+		wake.notify_all();
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		threads.clear();
+		queues.clear();
+	}
+
+	unsigned int threadCount() const {
+		return queues.empty() ? 1 : (unsigned int)queues.size();
+	}
+
+	//Calls function(begin, end) over [0, count) in chunks of at most grain items and returns once every
+	//chunk has run. Chunk c always covers [c * grain, (c + 1) * grain), whichever thread runs it.
+	template <typename Function>
+	void parallelFor(unsigned int count, unsigned int grain, Function function) {
+		if (grain == 0) {
+			grain = 1;
+		}
+		if (threads.empty() || count <= grain) {
+			for (unsigned int begin = 0; begin < count; begin += grain) {
+				function(begin, begin + grain < count ? begin + grain : count);
+			}
+			return;
+		}
+
+		unsigned int chunks = (count + grain - 1) / grain;
+		std::atomic<unsigned int> remaining(chunks);
+		//Counted before pushing, so a worker taking a job early never sees pending go below zero
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			pending += chunks;
+		}
+		for (unsigned int chunk = 0; chunk < chunks; chunk++) {
+			unsigned int begin = chunk * grain;
+			Job job = { &runFunction<Function>, &function, begin, begin + grain < count ? begin + grain : count, &remaining };
+			JobQueue& queue = *queues[chunk % queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back(job);
+		}
+		wake.notify_all();
+
+		//The caller works too instead of just waiting
+		while (remaining.load() > 0) {
+			Job job;
+			if (pop(0, job)) {
+				run(job);
+			}
+			else {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+private:
+	struct Job {
+		void (*function)(void* data, unsigned int begin, unsigned int end);
+		void* data;
+		unsigned int begin;
+		unsigned int end;
+		std::atomic<unsigned int>* remaining;
+	};
+
+	struct JobQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::unique_ptr<JobQueue>> queues;
+	std::vector<std::thread> threads;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	bool running = false;
+	//Jobs pushed but not taken yet, guarded by sleepMutex
+	unsigned int pending = 0;
+
+	template <typename Function>
+	static void runFunction(void* data, unsigned int begin, unsigned int end) {
+		(*(Function*)data)(begin, end);
+	}
+
+	void run(const Job& job) {
+		job.function(job.data, job.begin, job.end);
+		job.remaining->fetch_sub(1);
+	}
+
+	//Own deque first (newest job, still warm in cache), then the oldest job of every other thread
+	bool pop(unsigned int self, Job& job) {
+		size_t count = queues.size();
+		for (size_t i = 0; i < count; i++) {
+			size_t index = (self + i) % count;
+			JobQueue& queue = *queues[index];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.jobs.empty()) {
+				continue;
+			}
+			if (i == 0) {
+				job = queue.jobs.back();
+				queue.jobs.pop_back();
+			}
+			else {
+				job = queue.jobs.front();
+				queue.jobs.pop_front();
+			}
+			std::lock_guard<std::mutex> sleepLock(sleepMutex);
+			pending--;
+			return true;
+		}
+		return false;
+	}
+
+	void workerLoop(unsigned int self) {
+		while (true) {
+			Job job;
+			if (pop(self, job)) {
+				run(job);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wake.wait(lock, [this]() { return pending > 0 || !running; });
+			if (!running) {
+				return;
+			}
+		}
+	}
+};
+
+#endif // !JOBSYSTEM_H
@@ -0,0 +1,150 @@
+#ifndef MAPPEDFILE_H
+
+#define MAPPEDFILE_H
+
+#include <vector>
+#include <cstdio>
+
+#ifdef _WIN32
+//windows.h defines APIENTRY again, as the same __stdcall glad uses
+#ifdef APIENTRY
+#undef APIENTRY
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//Read-only view of a whole file without copying it into a std::string.
+//Large files are memory mapped, small ones are read straight into a single buffer since a map costs
+//more syscalls and page faults than one read. The data is NOT null terminated, always use size().
+class MappedFile {
+public:
+	//Files below this are read instead of mapped
+	static const size_t SMALL_FILE_SIZE = 16 * 1024;
+
+	//alwaysMap maps small files too, so data() is page aligned, and pages the whole file in right away
+	//instead of expecting a single front to back pass (MeshFile)
+	MappedFile(const char* path, bool alwaysMap = false) {
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			return;
+		}
+		length = (size_t)fileSize.QuadPart;
+		if (length < SMALL_FILE_SIZE && !(alwaysMap && length > 0)) {
+			buffer.resize(length);
+			DWORD read = 0;
+			if (length > 0 && (!ReadFile(file, buffer.data(), (DWORD)length, &read, NULL) || read != length)) {
+				return;
+			}
+			bytes = buffer.data();
+			opened = true;
+			return;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			return;
+		}
+		bytes = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		opened = mapped = bytes != NULL;
+#else
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd == -1) {
+			return;
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0) {
+			return;
+		}
+		length = (size_t)info.st_size;
+		if (length < SMALL_FILE_SIZE && !(alwaysMap && length > 0)) {
+			buffer.resize(length);
+			size_t total = 0;
+			while (total < length) {
+				ssize_t read = ::read(fd, buffer.data() + total, length - total);
+				if (read <= 0) {
+					return;
+				}
+				total += (size_t)read;
+			}
+			bytes = buffer.data();
+			opened = true;
+			return;
+		}
+		void* view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED) {
+			return;
+		}
+		//Shader sources are consumed front to back exactly once, meshes are read whole as soon as they are open
+		madvise(view, length, alwaysMap ? MADV_WILLNEED : MADV_SEQUENTIAL);
+		bytes = (const char*)view;
+		opened = mapped = true;
+#endif
+	}
+
+	~MappedFile() {
+#ifdef _WIN32
+		if (mapped) {
+			UnmapViewOfFile(bytes);
+		}
+		if (mapping != NULL) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+#else
+		if (mapped) {
+			munmap((void*)bytes, length);
+		}
+		if (fd != -1) {
+			close(fd);
+		}
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool isOpen() const {
+		return opened;
+	}
+
+	//Empty files are open with size 0, data() is then never NULL so it can still be handed to GL
+	const char* data() const {
+		return bytes != NULL ? bytes : "";
+	}
+
+	size_t size() const {
+		return opened ? length : 0;
+	}
+
+private:
+	const char* bytes = NULL;
+	size_t length = 0;
+	bool opened = false;
+	bool mapped = false;
+	std::vector<char> buffer;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int fd = -1;
+#endif
+};
+
+#endif // !MAPPEDFILE_H
@@ -0,0 +1,174 @@
+#ifndef MESHBATCHER_H
+
+#define MESHBATCHER_H
+
+#include <glad/glad.h>
+#include "GLStateCache.h"
+#include "GLHandles.h"
+#include "DrawCommand.h"
+#include "VertexFormat.h"
+#include "IndexBuffer.h"
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+//Packs many meshes that share a vertex layout into one VBO + EBO behind a single VAO.
+//Each mesh keeps its own (local) indices and is drawn with a base vertex, so meshes can be added
+//without rewriting their index data, and the indices only have to fit the biggest mesh: they are stored
+//as 16-bit (or split, see IndexBuffer) unless that mesh is huge. drawAll()/draw(list) submit any number
+//of them with one glMultiDrawElementsBaseVertex call and one VAO bind.
+class MeshBatcher {
+public:
+	VertexArrayHandle VAO;
+	BufferHandle VBO;
+	BufferHandle EBO;
+
+	MeshBatcher(unsigned int vertexStride) : stride(vertexStride) {}
+
+	//Same arguments as glVertexAttribPointer, offset is in bytes inside one vertex
+	void addAttribute(unsigned int index, int size, GLenum type, bool normalized, unsigned int offset) {
+		attributes.push_back(Attribute{ index, size, type, normalized, offset });
+	}
+
+	//From VertexFormat::getAttributes() or VertexLayout::getAttributes()
+	void addAttributes(const std::vector<VertexAttribute>& layout) {
+		for (const VertexAttribute& attribute : layout) {
+			addAttribute(attribute.index, attribute.size, attribute.type, attribute.normalized, attribute.offset);
+		}
+	}
+
+	//indices may be NULL for a plain triangle list, returns the mesh id used to draw it
+	unsigned int addMesh(const void* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount) {
+		GLint baseVertex = (GLint)(vertexData.size() / stride);
+		size_t offset = vertexData.size();
+		vertexData.resize(offset + (size_t)vertexCount * stride);
+		memcpy(vertexData.data() + offset, vertices, (size_t)vertexCount * stride);
+
+		if (indices != NULL) {
+			return indexData.addMesh(indices, indexCount, baseVertex);
+		}
+		std::vector<unsigned int> generated(vertexCount);
+		for (unsigned int i = 0; i < vertexCount; i++) {
+			generated[i] = i;
+		}
+		return indexData.addMesh(generated.data(), vertexCount, baseVertex);
+	}
+
+	//Creates the buffers with every mesh added so far, the CPU copies are released afterwards
+	void upload(GLStateCache& state) {
+		VAO = VertexArrayHandle::create(&state);
+		VBO = BufferHandle::create(&state);
+		EBO = BufferHandle::create(&state);
+		state.bindVertexArray(VAO.get());
+		state.bindBuffer(GL_ARRAY_BUFFER, VBO.get());
+		glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+		indexData.upload(state, EBO.get());
+		for (const Attribute& attribute : attributes) {
+			glVertexAttribPointer(attribute.index, attribute.size, attribute.type, attribute.normalized ? GL_TRUE : GL_FALSE,
+				(GLsizei)stride, (void*)(uintptr_t)attribute.offset);
+			glEnableVertexAttribArray(attribute.index);
+		}
+		state.bindVertexArray(0);
+		state.bindBuffer(GL_ARRAY_BUFFER, 0);
+
+		std::vector<char>().swap(vertexData);
+	}
+
+	//GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, after upload()
+	GLenum getIndexType() const {
+		return indexData.getType();
+	}
+
+	//Call before upload() to allow GL_UNSIGNED_BYTE indices, see IndexBuffer::smallestType
+	void setSmallestIndexType(GLenum type) {
+		indexData.smallestType = type;
+	}
+
+	void bind(GLStateCache& state) const {
+		state.bindVertexArray(VAO.get());
+	}
+
+	//Single mesh, for when meshes in the batch need different programs or uniforms
+	void draw(GLStateCache& state, unsigned int mesh) {
+		counts.clear();
+		offsets.clear();
+		baseVertices.clear();
+		addRanges(mesh);
+		if (counts.size() == 1) {
+			bind(state);
+			glDrawElementsBaseVertex(GL_TRIANGLES, counts[0], indexData.getType(), offsets[0], baseVertices[0]);
+			return;
+		}
+		submit(state);
+	}
+
+	//Any subset of the batch in one call
+	void draw(GLStateCache& state, const std::vector<unsigned int>& list) {
+		counts.clear();
+		offsets.clear();
+		baseVertices.clear();
+		for (unsigned int mesh : list) {
+			addRanges(mesh);
+		}
+		submit(state);
+	}
+
+	void drawAll(GLStateCache& state) {
+		counts.clear();
+		offsets.clear();
+		baseVertices.clear();
+		for (unsigned int mesh = 0; mesh < indexData.meshCount(); mesh++) {
+			addRanges(mesh);
+		}
+		submit(state);
+	}
+
+	//For queuing the mesh in a Renderer instead of drawing it right away, call after upload()
+	Mesh getMesh(unsigned int mesh) const {
+		return indexData.getMesh(VAO.get(), mesh);
+	}
+
+	unsigned int meshCount() const {
+		return indexData.meshCount();
+	}
+
+private:
+	struct Attribute {
+		unsigned int index;
+		int size;
+		GLenum type;
+		bool normalized;
+		unsigned int offset;
+	};
+	unsigned int stride;
+	std::vector<Attribute> attributes;
+	std::vector<char> vertexData;
+	IndexBuffer indexData;
+	//Scratch arrays for glMultiDrawElementsBaseVertex, kept around so drawing doesn't allocate
+	std::vector<GLsizei> counts;
+	std::vector<const void*> offsets;
+	std::vector<GLint> baseVertices;
+
+	//Queues every chunk of mesh for submit()
+	void addRanges(unsigned int mesh) {
+		const MeshChunk* chunks = indexData.getChunks(mesh);
+		unsigned int indexSize = indexTypeSize(indexData.getType());
+		for (unsigned int c = 0; c < indexData.getChunkCount(mesh); c++) {
+			counts.push_back(chunks[c].count);
+			offsets.push_back((const void*)(uintptr_t)(chunks[c].first * indexSize));
+			baseVertices.push_back(chunks[c].baseVertex);
+		}
+	}
+
+	void submit(GLStateCache& state) {
+		if (counts.empty()) {
+			return;
+		}
+		bind(state);
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), indexData.getType(),
+			(const void* const*)offsets.data(), (GLsizei)counts.size(), baseVertices.data());
+	}
+};
+
+#endif // !MESHBATCHER_H
@@ -0,0 +1,469 @@
+#ifndef MESHFILE_H
+
+#define MESHFILE_H
+
+#include <glad/glad.h>
+#include "VertexFormat.h"
+#include "DrawCommand.h"
+#include "MappedFile.h"
+
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+
+
+//"MESH" read as a little endian uint32_t
+const uint32_t MESH_FILE_MAGIC = 0x4853454D;
+const uint32_t MESH_FILE_VERSION = 1;
+//Blobs start on a cache line, so the mapping can be handed to glBufferData (or SIMD code) as it is
+const uint32_t MESH_FILE_ALIGNMENT = 64;
+//Blobs are stored as LZ4 chunks instead of raw
+const uint32_t MESH_FILE_COMPRESSED = 1;
+//Uncompressed bytes per chunk
+const uint32_t MESH_FILE_CHUNK_SIZE = 64 * 1024;
+
+//Layout of a .mesh file, little endian, offsets from the start of the file:
+//	MeshFileHeader
+//	MeshFileAttribute[attributeCount]
+//	vertex blob at vertexOffset, vertexBytes long, vertexCount * vertexStride bytes once decompressed
+//	index blob at indexOffset, indexBytes long, indexCount indices of indexType once decompressed
+//A compressed blob is a run of chunks: uint32_t raw size, uint32_t stored size, then the stored bytes, an LZ4 block
+//or the raw bytes when compressing didn't make the chunk smaller.
+struct MeshFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t flags;
+	uint32_t attributeCount;
+	uint32_t vertexCount;
+	uint32_t vertexStride;
+	uint32_t indexCount;
+	//GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	uint32_t indexType;
+	uint64_t vertexOffset;
+	uint64_t vertexBytes;
+	uint64_t indexOffset;
+	uint64_t indexBytes;
+	float boundsMin[3];
+	float boundsMax[3];
+};
+static_assert(sizeof(MeshFileHeader) == 88, "MeshFileHeader must not have padding");
+
+//A VertexAttribute as stored in the file
+struct MeshFileAttribute {
+	uint32_t location;
+	uint32_t size;
+	uint32_t type;
+	uint32_t normalized;
+	uint32_t offset;
+};
+
+//The LZ4 block format (no frame, no checksums), enough to read and write the chunks of a .mesh file
+namespace LZ4Block {
+	const size_t MIN_MATCH = 4;
+	//The format wants the last 5 bytes as literals and no match starting in the last 12
+	const size_t LAST_LITERALS = 5;
+	const size_t MATCH_FIND_LIMIT = 12;
+
+	//Fills destination exactly or fails, never reads or writes out of bounds on bad data
+	inline bool decompress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t destinationSize) {
+		size_t in = 0;
+		size_t out = 0;
+		while (in < sourceSize) {
+			unsigned char token = source[in++];
+			size_t literals = token >> 4;
+			if (literals == 15) {
+				unsigned char extra;
+				do {
+					if (in >= sourceSize) {
+						return false;
+					}
+					extra = source[in++];
+					literals += extra;
+				} while (extra == 255);
+			}
+			if (literals > sourceSize - in || literals > destinationSize - out) {
+				return false;
+			}
+			memcpy(destination + out, source + in, literals);
+			in += literals;
+			out += literals;
+			//The last sequence is literals only
+			if (in == sourceSize) {
+				break;
+			}
+
+			if (sourceSize - in < 2) {
+				return false;
+			}
+			size_t offset = source[in] | (source[in + 1] << 8);
+			in += 2;
+			size_t length = (token & 15) + MIN_MATCH;
+			if ((token & 15) == 15) {
+				unsigned char extra;
+				do {
+					if (in >= sourceSize) {
+						return false;
+					}
+					extra = source[in++];
+					length += extra;
+				} while (extra == 255);
+			}
+			if (offset == 0 || offset > out || length > destinationSize - out) {
+				return false;
+			}
+			//Byte by byte, the match may overlap what it is writing (offset < length repeats a pattern)
+			const unsigned char* match = destination + out - offset;
+			for (size_t i = 0; i < length; i++) {
+				destination[out + i] = match[i];
+			}
+			out += length;
+		}
+		return out == destinationSize;
+	}
+
+	//Greedy, one hash table of 4 byte sequences. Returns the compressed size, or 0 if it wouldn't fit in capacity
+	//(pass sourceSize - 1 to only keep results that are smaller)
+	inline size_t compress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t capacity) {
+		const unsigned int HASH_BITS = 12;
+		//Position + 1 of the last time each hash was seen, 0 for never
+		std::vector<size_t> table((size_t)1 << HASH_BITS, 0);
+		size_t out = 0;
+		size_t anchor = 0;
+
+		auto writeLength = [&](size_t length) {
+			while (length >= 255) {
+				if (out >= capacity) {
+					return false;
+				}
+				destination[out++] = 255;
+				length -= 255;
+			}
+			if (out >= capacity) {
+				return false;
+			}
+			destination[out++] = (unsigned char)length;
+			return true;
+		};
+		//Literals from anchor to end, then the match if length isn't 0
+		auto writeSequence = [&](size_t end, size_t offset, size_t length) {
+			size_t literals = end - anchor;
+			if (out >= capacity) {
+				return false;
+			}
+			size_t tokenAt = out++;
+			unsigned char token = (unsigned char)((literals < 15 ? literals : 15) << 4);
+			if (literals >= 15 && !writeLength(literals - 15)) {
+				return false;
+			}
+			if (literals > capacity - out) {
+				return false;
+			}
+			memcpy(destination + out, source + anchor, literals);
+			out += literals;
+			if (length > 0) {
+				if (capacity - out < 2) {
+					return false;
+				}
+				destination[out++] = (unsigned char)(offset & 0xFF);
+				destination[out++] = (unsigned char)(offset >> 8);
+				size_t matchCode = length - MIN_MATCH;
+				token |= (unsigned char)(matchCode < 15 ? matchCode : 15);
+				if (matchCode >= 15 && !writeLength(matchCode - 15)) {
+					return false;
+				}
+			}
+			destination[tokenAt] = token;
+			return true;
+		};
+
+		size_t i = 0;
+		while (i + MATCH_FIND_LIMIT <= sourceSize) {
+			uint32_t sequence;
+			memcpy(&sequence, source + i, 4);
+			uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+			size_t candidate = table[hash];
+			table[hash] = i + 1;
+			uint32_t candidateSequence = 0;
+			if (candidate != 0) {
+				memcpy(&candidateSequence, source + candidate - 1, 4);
+			}
+			if (candidate == 0 || i - (candidate - 1) > 65535 || candidateSequence != sequence) {
+				i++;
+				continue;
+			}
+			size_t matchStart = candidate - 1;
+			size_t length = MIN_MATCH;
+			while (i + length < sourceSize - LAST_LITERALS && source[matchStart + length] == source[i + length]) {
+				length++;
+			}
+			if (!writeSequence(i, i - matchStart, length)) {
+				return 0;
+			}
+			i += length;
+			anchor = i;
+		}
+		if (!writeSequence(sourceSize, 0, 0)) {
+			return 0;
+		}
+		return out;
+	}
+}
+
+//What MeshFile::write stores
+struct MeshFileContents {
+	const void* vertices = NULL;
+	unsigned int vertexCount = 0;
+	unsigned int vertexStride = 0;
+	std::vector<VertexAttribute> attributes;
+	//NULL for a plain triangle list
+	const void* indices = NULL;
+	unsigned int indexCount = 0;
+	GLenum indexType = GL_UNSIGNED_INT;
+	float boundsMin[3] = { 0.0f, 0.0f, 0.0f };
+	float boundsMax[3] = { 0.0f, 0.0f, 0.0f };
+};
+
+//A .mesh file mapped into memory. The header and attributes are read in place and an uncompressed mesh's vertex
+//and index data go to glBufferData straight from the mapping, so loading is the I/O and the upload, nothing else.
+//Compressed files are decompressed once, on the first getVertices()/getIndices(), into memory the MeshFile owns.
+//Pointers stay valid until close(). MeshConverter writes these files.
+class MeshFile {
+public:
+	MeshFile() {}
+	~MeshFile() {
+		close();
+	}
+	MeshFile(const MeshFile&) = delete;
+	MeshFile& operator=(const MeshFile&) = delete;
+
+	//Maps path and checks the header, errors are printed
+	bool open(const char* path) {
+		close();
+		file.reset(new MappedFile(path, true));
+		if (!file->isOpen() || file->size() < sizeof(MeshFileHeader)) {
+			std::cout << "ERROR::MESH_FILE::OPEN_FAILED\n" << path << std::endl;
+			close();
+			return false;
+		}
+		data = (const unsigned char*)file->data();
+		size = file->size();
+		if (!validate()) {
+			std::cout << "ERROR::MESH_FILE::INVALID\n" << path << std::endl;
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+		file.reset();
+		data = NULL;
+		size = 0;
+		std::vector<unsigned char>().swap(vertexData);
+		std::vector<unsigned char>().swap(indexData);
+	}
+
+	//Everything below is only valid after open() succeeded
+	const MeshFileHeader& getHeader() const {
+		return *(const MeshFileHeader*)data;
+	}
+
+	bool isCompressed() const {
+		return (getHeader().flags & MESH_FILE_COMPRESSED) != 0;
+	}
+
+	std::vector<VertexAttribute> getAttributes() const {
+		const MeshFileAttribute* stored = (const MeshFileAttribute*)(data + sizeof(MeshFileHeader));
+		std::vector<VertexAttribute> attributes;
+		for (uint32_t i = 0; i < getHeader().attributeCount; i++) {
+			VertexAttribute attribute = { stored[i].location, (int)stored[i].size, stored[i].type, stored[i].normalized != 0, stored[i].offset };
+			attributes.push_back(attribute);
+		}
+		return attributes;
+	}
+
+	//vertexCount * vertexStride bytes, NULL if the data is corrupt
+	const void* getVertices() {
+		const MeshFileHeader& header = getHeader();
+		return blob(header.vertexOffset, header.vertexBytes, (size_t)header.vertexCount * header.vertexStride, vertexData);
+	}
+
+	//indexCount indices of indexType, NULL for a plain triangle list or if the data is corrupt
+	const void* getIndices() {
+		const MeshFileHeader& header = getHeader();
+		if (header.indexCount == 0) {
+			return NULL;
+		}
+		return blob(header.indexOffset, header.indexBytes, (size_t)header.indexCount * indexTypeSize(header.indexType), indexData);
+	}
+
+	//Writes contents to path, compressed in LZ4 chunks if compress is set. Returns false if the file can't be written
+	static bool write(const char* path, const MeshFileContents& contents, bool compress) {
+		MeshFileHeader header = {};
+		header.magic = MESH_FILE_MAGIC;
+		header.version = MESH_FILE_VERSION;
+		header.flags = compress ? MESH_FILE_COMPRESSED : 0;
+		header.attributeCount = (uint32_t)contents.attributes.size();
+		header.vertexCount = contents.vertexCount;
+		header.vertexStride = contents.vertexStride;
+		header.indexCount = contents.indices != NULL ? contents.indexCount : 0;
+		header.indexType = contents.indexType;
+		memcpy(header.boundsMin, contents.boundsMin, sizeof(header.boundsMin));
+		memcpy(header.boundsMax, contents.boundsMax, sizeof(header.boundsMax));
+
+		std::vector<unsigned char> vertexBlob = encode(contents.vertices, (size_t)contents.vertexCount * contents.vertexStride, compress);
+		std::vector<unsigned char> indexBlob = encode(contents.indices, (size_t)header.indexCount * indexTypeSize(contents.indexType), compress);
+		header.vertexOffset = align(sizeof(MeshFileHeader) + sizeof(MeshFileAttribute) * contents.attributes.size());
+		header.vertexBytes = vertexBlob.size();
+		header.indexOffset = align(header.vertexOffset + header.vertexBytes);
+		header.indexBytes = indexBlob.size();
+
+		std::vector<unsigned char> file((size_t)(header.indexOffset + header.indexBytes), 0);
+		memcpy(file.data(), &header, sizeof(header));
+		for (size_t i = 0; i < contents.attributes.size(); i++) {
+			const VertexAttribute& attribute = contents.attributes[i];
+			MeshFileAttribute stored = { attribute.index, (uint32_t)attribute.size, attribute.type, attribute.normalized ? 1u : 0u, attribute.offset };
+			memcpy(file.data() + sizeof(header) + i * sizeof(stored), &stored, sizeof(stored));
+		}
+		if (!vertexBlob.empty()) {
+			memcpy(file.data() + header.vertexOffset, vertexBlob.data(), vertexBlob.size());
+		}
+		if (!indexBlob.empty()) {
+			memcpy(file.data() + header.indexOffset, indexBlob.data(), indexBlob.size());
+		}
+		std::ofstream out(path, std::ios::binary);
+		out.write((const char*)file.data(), (std::streamsize)file.size());
+		return (bool)out;
+	}
+
+private:
+	std::unique_ptr<MappedFile> file;
+	const unsigned char* data = NULL;
+	size_t size = 0;
+	std::vector<unsigned char> vertexData;
+	std::vector<unsigned char> indexData;
+
+	static uint64_t align(uint64_t offset) {
+		return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+	}
+
+	bool validate() const {
+		const MeshFileHeader& header = getHeader();
+		if (header.magic != MESH_FILE_MAGIC || header.version != MESH_FILE_VERSION || header.attributeCount > 16
+			|| header.vertexCount == 0 || header.vertexStride == 0 || (header.indexType != GL_UNSIGNED_SHORT && header.indexType != GL_UNSIGNED_INT)) {
+			return false;
+		}
+		if (sizeof(MeshFileHeader) + sizeof(MeshFileAttribute) * header.attributeCount > size
+			|| header.vertexOffset > size || header.vertexBytes > size - header.vertexOffset
+			|| header.indexOffset > size || header.indexBytes > size - header.indexOffset) {
+			return false;
+		}
+		if (!isCompressed() && (header.vertexBytes != (uint64_t)header.vertexCount * header.vertexStride
+			|| header.indexBytes != (uint64_t)header.indexCount * indexTypeSize(header.indexType))) {
+			return false;
+		}
+		//Every attribute has to lie inside the stride, or GL would read past the end of the vertex buffer
+		const MeshFileAttribute* attributes = (const MeshFileAttribute*)(data + sizeof(MeshFileHeader));
+		for (uint32_t i = 0; i < header.attributeCount; i++) {
+			const MeshFileAttribute& attribute = attributes[i];
+			uint64_t bytes = attributeSize(attribute);
+			if (attribute.location >= 16 || bytes == 0 || (uint64_t)attribute.offset + bytes > header.vertexStride) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//Bytes one vertex's attribute takes, 0 if the size or type isn't one GL accepts
+	static uint64_t attributeSize(const MeshFileAttribute& attribute) {
+		if (attribute.type == GL_INT_2_10_10_10_REV || attribute.type == GL_UNSIGNED_INT_2_10_10_10_REV) {
+			return attribute.size == 4 ? 4 : 0;
+		}
+		if (attribute.size < 1 || attribute.size > 4) {
+			return 0;
+		}
+		switch (attribute.type) {
+		case GL_BYTE:
+		case GL_UNSIGNED_BYTE:
+			return attribute.size;
+		case GL_SHORT:
+		case GL_UNSIGNED_SHORT:
+		case GL_HALF_FLOAT:
+			return attribute.size * 2;
+		case GL_INT:
+		case GL_UNSIGNED_INT:
+		case GL_FLOAT:
+			return attribute.size * 4;
+		default:
+			return 0;
+		}
+	}
+
+	//The blob at offset as rawSize plain bytes, decompressed into scratch if needed
+	const void* blob(uint64_t offset, uint64_t storedSize, size_t rawSize, std::vector<unsigned char>& scratch) {
+		if (!isCompressed()) {
+			return data + offset;
+		}
+		if (scratch.size() == rawSize && rawSize > 0) {
+			return scratch.data();
+		}
+		scratch.resize(rawSize);
+		const unsigned char* in = data + offset;
+		const unsigned char* end = in + storedSize;
+		size_t out = 0;
+		while (in < end) {
+			uint32_t chunkRaw;
+			uint32_t chunkStored;
+			if (end - in < 8) {
+				break;
+			}
+			memcpy(&chunkRaw, in, 4);
+			memcpy(&chunkStored, in + 4, 4);
+			in += 8;
+			if (chunkStored > (size_t)(end - in) || chunkRaw > rawSize - out) {
+				break;
+			}
+			if (chunkStored == chunkRaw) {
+				memcpy(scratch.data() + out, in, chunkRaw);
+			}
+			else if (!LZ4Block::decompress(in, chunkStored, scratch.data() + out, chunkRaw)) {
+				break;
+			}
+			in += chunkStored;
+			out += chunkRaw;
+		}
+		if (in != end || out != rawSize) {
+			std::cout << "ERROR::MESH_FILE::CORRUPT_CHUNK" << std::endl;
+			scratch.clear();
+			return NULL;
+		}
+		return scratch.data();
+	}
+
+	static std::vector<unsigned char> encode(const void* source, size_t sourceSize, bool compress) {
+		const unsigned char* bytes = (const unsigned char*)source;
+		if (!compress) {
+			return std::vector<unsigned char>(bytes, bytes + sourceSize);
+		}
+		std::vector<unsigned char> blob;
+		std::vector<unsigned char> compressed(MESH_FILE_CHUNK_SIZE);
+		for (size_t offset = 0; offset < sourceSize; offset += MESH_FILE_CHUNK_SIZE) {
+			uint32_t chunkRaw = (uint32_t)(sourceSize - offset < MESH_FILE_CHUNK_SIZE ? sourceSize - offset : MESH_FILE_CHUNK_SIZE);
+			size_t compressedSize = LZ4Block::compress(bytes + offset, chunkRaw, compressed.data(), chunkRaw - 1);
+			//Not smaller, keep it raw
+			uint32_t chunkStored = compressedSize > 0 ? (uint32_t)compressedSize : chunkRaw;
+			const unsigned char* stored = compressedSize > 0 ? compressed.data() : bytes + offset;
+			size_t at = blob.size();
+			blob.resize(at + 8 + chunkStored);
+			memcpy(blob.data() + at, &chunkRaw, 4);
+			memcpy(blob.data() + at + 4, &chunkStored, 4);
+			memcpy(blob.data() + at + 8, stored, chunkStored);
+		}
+		return blob;
+	}
+};
+
+#endif // !MESHFILE_H
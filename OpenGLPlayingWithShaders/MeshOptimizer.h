@@ -0,0 +1,427 @@
+#ifndef MESHOPTIMIZER_H
+
+#define MESHOPTIMIZER_H
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+//Post-transform vertex cache behaviour of an index buffer, simulated with a FIFO cache
+struct VertexCacheStats {
+	//Average cache miss ratio, vertex shader runs per triangle. 3 is the worst, about 0.5 the best a big grid gets
+	float acmr = 0.0f;
+	//Average transformed vertex ratio, vertex shader runs per vertex used. 1 is the best
+	float atvr = 0.0f;
+	unsigned int misses = 0;
+};
+
+//What optimizeMesh() did
+struct MeshOptimizerReport {
+	unsigned int verticesBefore = 0;
+	unsigned int verticesAfter = 0;
+	VertexCacheStats before;
+	VertexCacheStats after;
+
+	void print(const char* name) const {
+		std::cout << "MESH_OPTIMIZER::" << name << ": " << verticesBefore << " -> " << verticesAfter << " vertices, ACMR "
+			<< before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+	}
+};
+
+//Reorders triangle lists so the GPU runs the vertex shader fewer times and fetches less memory, at load time or
+//offline. The steps, in the order optimizeMesh() runs them:
+//	deduplicate			merges vertices that are identical byte for byte
+//	optimizeVertexCache	Tom Forsyth's linear-speed vertex cache optimization, triangles that reuse recently
+//						transformed vertices go next
+//	optimizeOverdraw	splits the result into clusters where that costs little cache efficiency and sorts them
+//						so triangles facing out from the mesh center are drawn first and hide the ones behind
+//	optimizeVertexFetch	renumbers vertices in the order the indices use them, so fetches walk memory forward
+//Indices are 32-bit triangle lists, positions 3 floats somewhere inside each vertex.
+namespace MeshOptimizer {
+	//FIFO size the stats assume, close to what current GPUs reuse
+	const unsigned int STATS_CACHE_SIZE = 16;
+	//LRU size Forsyth's scoring models
+	const unsigned int FORSYTH_CACHE_SIZE = 32;
+
+	inline VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount, unsigned int vertexCount,
+		unsigned int cacheSize = STATS_CACHE_SIZE) {
+		VertexCacheStats stats;
+		//A vertex is cached while fewer than cacheSize misses happened after its own
+		std::vector<unsigned int> missTime(vertexCount, 0);
+		std::vector<bool> used(vertexCount, false);
+		unsigned int time = cacheSize + 1;
+		unsigned int usedCount = 0;
+		for (size_t i = 0; i < indexCount; i++) {
+			unsigned int vertex = indices[i];
+			if (time - missTime[vertex] > cacheSize) {
+				missTime[vertex] = time++;
+				stats.misses++;
+			}
+			if (!used[vertex]) {
+				used[vertex] = true;
+				usedCount++;
+			}
+		}
+		size_t triangles = indexCount / 3;
+		stats.acmr = triangles > 0 ? (float)stats.misses / triangles : 0.0f;
+		stats.atvr = usedCount > 0 ? (float)stats.misses / usedCount : 0.0f;
+		return stats;
+	}
+
+	//remap[v] is the new index of vertex v, the first of identical vertices keeps its place. Returns the number left
+	inline unsigned int deduplicate(std::vector<unsigned int>& remap, const void* vertices, unsigned int vertexCount, unsigned int stride) {
+		const unsigned char* data = (const unsigned char*)vertices;
+		const unsigned int EMPTY = ~0u;
+		size_t tableSize = 1;
+		while (tableSize < (size_t)vertexCount * 2) {
+			tableSize *= 2;
+		}
+		//Open addressing, holds the first vertex of every distinct value
+		std::vector<unsigned int> table(tableSize, EMPTY);
+		remap.assign(vertexCount, EMPTY);
+		unsigned int unique = 0;
+		for (unsigned int v = 0; v < vertexCount; v++) {
+			const unsigned char* vertex = data + (size_t)v * stride;
+			//FNV-1a
+			uint32_t hash = 2166136261u;
+			for (unsigned int b = 0; b < stride; b++) {
+				hash = (hash ^ vertex[b]) * 16777619u;
+			}
+			size_t slot = hash & (tableSize - 1);
+			while (table[slot] != EMPTY && memcmp(data + (size_t)table[slot] * stride, vertex, stride) != 0) {
+				slot = (slot + 1) & (tableSize - 1);
+			}
+			if (table[slot] == EMPTY) {
+				table[slot] = v;
+				remap[v] = unique++;
+			}
+			else {
+				remap[v] = remap[table[slot]];
+			}
+		}
+		return unique;
+	}
+
+	//destination holds vertexCount entries, remap comes from deduplicate()
+	inline void remapVertexBuffer(void* destination, const void* vertices, unsigned int vertexCount, unsigned int stride,
+		const std::vector<unsigned int>& remap) {
+		for (unsigned int v = 0; v < vertexCount; v++) {
+			memcpy((unsigned char*)destination + (size_t)remap[v] * stride, (const unsigned char*)vertices + (size_t)v * stride, stride);
+		}
+	}
+
+	inline void remapIndexBuffer(unsigned int* indices, size_t indexCount, const std::vector<unsigned int>& remap) {
+		for (size_t i = 0; i < indexCount; i++) {
+			indices[i] = remap[indices[i]];
+		}
+	}
+
+	//Forsyth's vertex score: recently used vertices score high (the last triangle's three a bit lower so strips
+	//don't just turn around), and vertices with few triangles left get a boost so they are finished off
+	inline float forsythScore(int cachePosition, unsigned int trianglesLeft) {
+		if (trianglesLeft == 0) {
+			return -1.0f;
+		}
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			if (cachePosition < 3) {
+				score = 0.75f;
+			}
+			else {
+				score = powf(1.0f - (float)(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+			}
+		}
+		return score + 2.0f / sqrtf((float)trianglesLeft);
+	}
+
+	//indices may be the same array as destination
+	inline void optimizeVertexCache(unsigned int* destination, const unsigned int* indices, size_t indexCount, unsigned int vertexCount) {
+		std::vector<unsigned int> source(indices, indices + indexCount);
+		size_t triangleCount = indexCount / 3;
+
+		//Triangles around each vertex, the first trianglesLeft[v] of them not emitted yet
+		std::vector<unsigned int> trianglesLeft(vertexCount, 0);
+		for (size_t i = 0; i < triangleCount * 3; i++) {
+			trianglesLeft[source[i]]++;
+		}
+		std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+		for (unsigned int v = 0; v < vertexCount; v++) {
+			firstTriangle[v + 1] = firstTriangle[v] + trianglesLeft[v];
+		}
+		std::vector<unsigned int> adjacency(triangleCount * 3);
+		std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++) {
+			for (int c = 0; c < 3; c++) {
+				unsigned int vertex = source[t * 3 + c];
+				adjacency[filled[vertex]++] = (unsigned int)t;
+			}
+		}
+
+		std::vector<int> cachePosition(vertexCount, -1);
+		std::vector<float> vertexScore(vertexCount);
+		for (unsigned int v = 0; v < vertexCount; v++) {
+			vertexScore[v] = forsythScore(-1, trianglesLeft[v]);
+		}
+		std::vector<bool> emitted(triangleCount, false);
+		size_t best = 0;
+		float bestScore = -1.0f;
+		for (size_t t = 0; t < triangleCount; t++) {
+			float score = vertexScore[source[t * 3]] + vertexScore[source[t * 3 + 1]] + vertexScore[source[t * 3 + 2]];
+			if (score > bestScore) {
+				bestScore = score;
+				best = t;
+			}
+		}
+
+		//Room for a full cache plus the triangle pushed in front of it
+		std::vector<unsigned int> cache;
+		std::vector<unsigned int> newCache;
+		cache.reserve(FORSYTH_CACHE_SIZE + 3);
+		newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+		size_t output = 0;
+		size_t deadEndCursor = 0;
+		while (output < triangleCount) {
+			const unsigned int* triangle = &source[best * 3];
+			emitted[best] = true;
+			memcpy(destination + output * 3, triangle, 3 * sizeof(unsigned int));
+			output++;
+
+			newCache.assign(triangle, triangle + 3);
+			for (int c = 0; c < 3; c++) {
+				//Take the triangle out of its vertices' live lists
+				unsigned int vertex = triangle[c];
+				unsigned int* begin = &adjacency[firstTriangle[vertex]];
+				unsigned int* end = begin + trianglesLeft[vertex];
+				unsigned int* found = std::find(begin, end, (unsigned int)best);
+				std::swap(*found, *(end - 1));
+				trianglesLeft[vertex]--;
+			}
+			for (unsigned int vertex : cache) {
+				if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+					newCache.push_back(vertex);
+				}
+			}
+			//Whatever falls off the end is no longer cached
+			for (size_t i = FORSYTH_CACHE_SIZE; i < newCache.size(); i++) {
+				cachePosition[newCache[i]] = -1;
+				vertexScore[newCache[i]] = forsythScore(-1, trianglesLeft[newCache[i]]);
+			}
+			if (newCache.size() > FORSYTH_CACHE_SIZE) {
+				newCache.resize(FORSYTH_CACHE_SIZE);
+			}
+			cache.swap(newCache);
+			for (size_t i = 0; i < cache.size(); i++) {
+				cachePosition[cache[i]] = (int)i;
+				vertexScore[cache[i]] = forsythScore((int)i, trianglesLeft[cache[i]]);
+			}
+
+			//Only triangles touching the cache changed score, the next one is the best of them
+			bestScore = -1.0f;
+			for (unsigned int vertex : cache) {
+				for (unsigned int i = 0; i < trianglesLeft[vertex]; i++) {
+					unsigned int t = adjacency[firstTriangle[vertex] + i];
+					float score = vertexScore[source[t * 3]] + vertexScore[source[t * 3 + 1]] + vertexScore[source[t * 3 + 2]];
+					if (score > bestScore) {
+						bestScore = score;
+						best = t;
+					}
+				}
+			}
+			if (bestScore < 0.0f) {
+				//Dead end, nothing left around the cache. Carry on with the first triangle not drawn yet
+				while (deadEndCursor < triangleCount && emitted[deadEndCursor]) {
+					deadEndCursor++;
+				}
+				best = deadEndCursor;
+			}
+		}
+		//Leftover indices of an incomplete triangle stay at the end
+		for (size_t i = triangleCount * 3; i < indexCount; i++) {
+			destination[i] = source[i];
+		}
+	}
+
+	//Call on the output of optimizeVertexCache(). threshold is how much worse than the cache optimized order the
+	//ACMR of a cluster may get for the clusters to be split there, 1.05 allows 5%
+	inline void optimizeOverdraw(unsigned int* destination, const unsigned int* indices, size_t indexCount, const void* vertices,
+		unsigned int vertexCount, unsigned int stride, unsigned int positionOffset, float threshold = 1.05f) {
+		std::vector<unsigned int> source(indices, indices + indexCount);
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0) {
+			return;
+		}
+		const unsigned char* data = (const unsigned char*)vertices;
+		auto position = [&](unsigned int vertex) {
+			return (const float*)(data + (size_t)vertex * stride + positionOffset);
+		};
+
+		//Hard boundaries are triangles that miss all three vertices, the cache order jumped somewhere else anyway.
+		//Soft boundaries are added inside those where the cluster so far already does as well as threshold allows,
+		//each cluster then starts with a cold cache so the whole order stays close to the original ACMR
+		std::vector<size_t> clusterStarts;
+		std::vector<unsigned int> missTime(vertexCount, 0);
+		unsigned int time = STATS_CACHE_SIZE + 1;
+		auto triangleMisses = [&](size_t t) {
+			unsigned int misses = 0;
+			for (int c = 0; c < 3; c++) {
+				unsigned int vertex = source[t * 3 + c];
+				if (time - missTime[vertex] > STATS_CACHE_SIZE) {
+					missTime[vertex] = time++;
+					misses++;
+				}
+			}
+			return misses;
+		};
+		std::vector<size_t> hardStarts;
+		for (size_t t = 0; t < triangleCount; t++) {
+			if (triangleMisses(t) == 3) {
+				hardStarts.push_back(t);
+			}
+		}
+		hardStarts.push_back(triangleCount);
+		for (size_t h = 0; h + 1 < hardStarts.size(); h++) {
+			size_t begin = hardStarts[h];
+			size_t end = hardStarts[h + 1];
+			time += STATS_CACHE_SIZE + 1;
+			unsigned int hardMisses = 0;
+			for (size_t t = begin; t < end; t++) {
+				hardMisses += triangleMisses(t);
+			}
+			float limit = threshold * hardMisses / (end - begin);
+
+			time += STATS_CACHE_SIZE + 1;
+			size_t clusterStart = begin;
+			unsigned int clusterMisses = 0;
+			clusterStarts.push_back(begin);
+			for (size_t t = begin; t < end; t++) {
+				clusterMisses += triangleMisses(t);
+				if (t + 1 < end && (float)clusterMisses / (t + 1 - clusterStart) <= limit) {
+					clusterStart = t + 1;
+					clusterMisses = 0;
+					clusterStarts.push_back(clusterStart);
+					time += STATS_CACHE_SIZE + 1;
+				}
+			}
+		}
+		clusterStarts.push_back(triangleCount);
+
+		//Area weighted centroid and normal of every cluster and of the whole mesh
+		struct Cluster {
+			size_t begin;
+			size_t end;
+			float sortKey;
+		};
+		std::vector<Cluster> clusters;
+		std::vector<float> clusterData((clusterStarts.size() - 1) * 7, 0.0f);
+		float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+		float meshArea = 0.0f;
+		for (size_t c = 0; c + 1 < clusterStarts.size(); c++) {
+			float* centroid = &clusterData[c * 7];
+			float* normal = centroid + 3;
+			float& area = centroid[6];
+			for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+				const float* a = position(source[t * 3]);
+				const float* b = position(source[t * 3 + 1]);
+				const float* d = position(source[t * 3 + 2]);
+				float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+				float e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+				float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+				float triangleArea = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				for (int k = 0; k < 3; k++) {
+					centroid[k] += (a[k] + b[k] + d[k]) / 3.0f * triangleArea;
+					normal[k] += n[k];
+				}
+				area += triangleArea;
+			}
+			for (int k = 0; k < 3; k++) {
+				meshCentroid[k] += centroid[k];
+			}
+			meshArea += area;
+		}
+		for (int k = 0; k < 3; k++) {
+			meshCentroid[k] = meshArea > 0.0f ? meshCentroid[k] / meshArea : 0.0f;
+		}
+		for (size_t c = 0; c + 1 < clusterStarts.size(); c++) {
+			const float* centroid = &clusterData[c * 7];
+			const float* normal = centroid + 3;
+			float area = centroid[6];
+			float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			float key = 0.0f;
+			if (area > 0.0f && length > 0.0f) {
+				for (int k = 0; k < 3; k++) {
+					key += (centroid[k] / area - meshCentroid[k]) * normal[k] / length;
+				}
+			}
+			clusters.push_back(Cluster{ clusterStarts[c], clusterStarts[c + 1], key });
+		}
+		//Most outward facing first, ties keep the cache order
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+			return a.sortKey > b.sortKey;
+		});
+
+		size_t output = 0;
+		for (const Cluster& cluster : clusters) {
+			size_t count = (cluster.end - cluster.begin) * 3;
+			memcpy(destination + output, &source[cluster.begin * 3], count * sizeof(unsigned int));
+			output += count;
+		}
+		for (size_t i = triangleCount * 3; i < indexCount; i++) {
+			destination[i] = source[i];
+		}
+	}
+
+	//Renumbers vertices in the order the indices first use them, rewriting indices in place. Unused vertices are
+	//dropped, destination needs room for vertexCount of them. Returns the new vertex count
+	inline unsigned int optimizeVertexFetch(void* destination, unsigned int* indices, size_t indexCount, const void* vertices,
+		unsigned int vertexCount, unsigned int stride) {
+		const unsigned int UNUSED = ~0u;
+		std::vector<unsigned int> remap(vertexCount, UNUSED);
+		unsigned int next = 0;
+		for (size_t i = 0; i < indexCount; i++) {
+			unsigned int& target = remap[indices[i]];
+			if (target == UNUSED) {
+				memcpy((unsigned char*)destination + (size_t)next * stride, (const unsigned char*)vertices + (size_t)indices[i] * stride, stride);
+				target = next++;
+			}
+			indices[i] = target;
+		}
+		return next;
+	}
+
+	//Every step on one mesh, in place. vertices holds whole vertices of stride bytes, indices may be empty for a
+	//plain triangle list (one is generated)
+	inline MeshOptimizerReport optimizeMesh(std::vector<unsigned char>& vertices, unsigned int stride, std::vector<unsigned int>& indices,
+		unsigned int positionOffset) {
+		MeshOptimizerReport report;
+		unsigned int vertexCount = (unsigned int)(vertices.size() / stride);
+		report.verticesBefore = vertexCount;
+		if (indices.empty()) {
+			for (unsigned int v = 0; v < vertexCount; v++) {
+				indices.push_back(v);
+			}
+		}
+		report.before = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+		std::vector<unsigned int> remap;
+		unsigned int unique = deduplicate(remap, vertices.data(), vertexCount, stride);
+		std::vector<unsigned char> scratch((size_t)unique * stride);
+		remapVertexBuffer(scratch.data(), vertices.data(), vertexCount, stride, remap);
+		remapIndexBuffer(indices.data(), indices.size(), remap);
+		vertexCount = unique;
+
+		optimizeVertexCache(indices.data(), indices.data(), indices.size(), vertexCount);
+		optimizeOverdraw(indices.data(), indices.data(), indices.size(), scratch.data(), vertexCount, stride, positionOffset);
+		vertices.resize(scratch.size());
+		vertexCount = optimizeVertexFetch(vertices.data(), indices.data(), indices.size(), scratch.data(), vertexCount, stride);
+		vertices.resize((size_t)vertexCount * stride);
+
+		report.verticesAfter = vertexCount;
+		report.after = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+		return report;
+	}
+}
+
+#endif // !MESHOPTIMIZER_H
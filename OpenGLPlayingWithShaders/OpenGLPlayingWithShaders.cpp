@@ -1,101 +1,50 @@
 #include<glad/glad.h>
 #include<GLFW/glfw3.h>
+#include"Renderer.h"
 #include"Shader.h"
+#include"ShaderWatcher.h"
+#include"ShaderPreprocessor.h"
+#include"UniformBlock.h"
 #include <iostream>
+#include <cmath>
 
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
-const char* vertexShaderSource = "#version 330 core\n"
-"layout (location = 0) in vec3 aPos;\n"
-"layout (location = 1) in vec3 color;\n"
-"out vec3 vertexColor;\n"
-"void main() {\n"
-"gl_Position = vec4(aPos, 1.0);\n"
-"vertexColor = color;\n"
-"}\0";
-const char* fragmentShaderOrangeSource = "#version 330 core\n"
-"uniform vec4 customColor;\n"
-//"in vec3 vertexColor;\n"
-"out vec4 RGBA;\n"
-"void main() {\n"
-"	RGBA = customColor;\n"
-"}\0";
-const char* fragmentShaderYellowSource = "#version 330 core\n"
-"out vec4 RGBA;\n"
-"in vec3 vertexColor;\n"
-"void main() {\n"
-"	RGBA = vec4(vertexColor, 1.0f);\n"
-"}\0";
+//Layout of the FrameData block in FrameData.txt, std140 rules
+struct FrameData {
+	std140::vec4 customColor;
+	float time;
+};
 
-void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-	glViewport(0, 0, width, height);
-}
-
-void processInput(GLFWwindow* window) {
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-		glfwSetWindowShouldClose(window, true);
-	}
-}
-
-void shaderCompile(unsigned int shader, const char* shaderSource, const char* message) {
-	int success;
-	char infoLog[512];
-
-	//Attach the shader source code to the object and compile it
-	glShaderSource(shader, 1, &shaderSource, NULL);
-	glCompileShader(shader);
-
-	//Check if compiled succesfully
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-
-	if (!success) {
-		glGetShaderInfoLog(shader, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::" << message << "::COMPILATION_FAILED\n" << infoLog << std::endl;
-	}
-}
-
-void shaderProgramCompile(unsigned int shaderProgram) {
-	glLinkProgram(shaderProgram);
-
-	//Check for compile errors
-	int success;
-	char infoLog[512];
-	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-	if (!success) {
-		glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::PROGRAM::COMPILATION_FAILED" << infoLog << std::endl;
-	}
-}
-
-
-int main()
+int main(int argc, char** argv)
 {
 	///////////
 	// SETUP //
 	///////////
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Hello OpenGL", NULL, NULL);
-	//Checks if window is not created, print message, terminate glfw.
-	if (window == NULL) {
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
-		return -1;
-	}
-	glfwMakeContextCurrent(window);
-	//set the function we created to be called on every window resize.
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-	//Load GLAD, with GLFW passing the address of the OpenGL functions for it to load
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-		std::cout << "Failed to initiate GLAD" << std::endl;
-		glfwTerminate();
+	//A window, or an offscreen framebuffer when run with --headless
+	Renderer renderer;
+	if (!renderer.init(argc, argv, "Hello OpenGL", SCR_WIDTH, SCR_HEIGHT)) {
 		return -1;
 	}
 
-	Shader firstShader("./VertexShader.txt", "./FragmentShader.txt");
+	//Linked programs are kept in ./ShaderCache so later runs skip compiling the GLSL
+	ShaderCache shaderCache("./ShaderCache");
+	shaderCache.init(renderer.context.loader());
+	Shader firstShader("./VertexShader.txt", "./FragmentShader.txt", &shaderCache);
+	shaderCache.printStats();
+	//Edits to the shader files are picked up while running
+	ShaderWatcher shaderWatcher;
+	shaderWatcher.init(renderer.context.loader(), &renderer.state);
+	shaderWatcher.watch(firstShader);
+	//Per-frame values live in one uniform buffer, created first so the programs below bind to it on link
+	UniformBlock<FrameData> frameData("FrameData", 0);
+	frameData.create(renderer.state);
+	//One fragment source specialized at compile time for each COLOR_SOURCE, instead of a runtime branch
+	ShaderVariants colorShaders("./VertexShader.txt", "./VariantFragmentShader.txt");
+	colorShaders.addOption("COLOR_SOURCE", { "COLOR_CONSTANT", "COLOR_VERTEX", "COLOR_UNIFORM" });
+	colorShaders.build(&shaderCache);
+	Shader* uniformColorShader = colorShaders.get("COLOR_SOURCE=COLOR_UNIFORM");
 
 	//\/\/\/\/\/\/\/\/\/\//
 	//    VERTEX DATA    //
@@ -111,55 +60,48 @@ int main()
 		1.0f, -0.5f, 0.0f,		0.0f, 1.0f, 0.0f, //bottom right
 		0.5f, 0.5f, 0.0f,		0.0f, 0.0f, 1.0f //middle top
 	};
-	//Create VAO (Vertex Array Object)
-	unsigned int VAO[2], VBO[2];
-	glGenVertexArrays(2, VAO);
-	glGenBuffers(2, VBO);
-	//TRIANGLE 1
-	glBindVertexArray(VAO[0]);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(v_triangle1), v_triangle1, GL_STATIC_DRAW);
-	//position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3* sizeof(float)));
-	glEnableVertexAttribArray(1);
-	//glBindVertexArray(0); //No need to bind since we are setting up another VAO
-	//TRIANGLE 2
-	glBindVertexArray(VAO[1]);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(v_triangle2), v_triangle2, GL_STATIC_DRAW);
-	//position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3* sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	//Stored as half float positions and normalized byte colors, 12 bytes per vertex instead of 24
+	typedef VertexLayout<Attr<0, 3, VertexType::Half>, Attr<1, 3, VertexType::UNorm8>> CompactVertex;
+	CompactVertex::validate(firstShader.ID, "FIRST_SHADER");
+	CompactVertex::validate(uniformColorShader->ID, "UNIFORM_COLOR_SHADER");
+	VertexFormat compact = CompactVertex::getFormat();
+	std::vector<unsigned char> packed;
+	compact.pack(v_triangle1, 6, 3, packed);
+	Mesh triangle1 = renderer.createMesh<CompactVertex>(packed.data(), 3, NULL, 0);
+	compact.pack(v_triangle2, 6, 3, packed);
+	Mesh triangle2 = renderer.createMesh<CompactVertex>(packed.data(), 3, NULL, 0);
 
 	/////////////////
 	// RENDER LOOP //
 	/////////////////
-	while (!glfwWindowShouldClose(window)) {
-		//Input
-		processInput(window);
-
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		firstShader.use();
-		//firstShader.setFloat("someUniform", 1.0f);
-		glBindVertexArray(VAO[1]);
-		//Draw triangle primitives, starting at index 0 on the VAO, using 3 vertices
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-
-		//Call Events and Buffer Swap
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-	}
+	//Per-pass CPU and GPU times, --trace file.json saves them for chrome://tracing
+	FrameProfiler& profiler = renderer.profiler;
+	renderer.run([&]() {
+		{
+			CpuZone zone(profiler, "Shader reload");
+			shaderWatcher.update();
+		}
+
+		{
+			CpuZone cpuZone(profiler, "Frame data");
+			GpuZone gpuZone(profiler, "Frame data");
+			//One upload per frame, no matter how many programs read it
+			float time = (float)renderer.context.getTime();
+			frameData.data.customColor = std140::vec4{ 0.0f, sinf(time) / 2.0f + 0.5f, 0.0f, 1.0f };
+			frameData.data.time = time;
+			frameData.upload(renderer.state);
+		}
+
+		{
+			CpuZone cpuZone(profiler, "Triangles");
+			GpuZone gpuZone(profiler, "Triangles");
+			//Hot reload can swap the program names, so they are read every frame
+			renderer.draw(firstShader.ID, triangle2);
+			renderer.draw(uniformColorShader->ID, triangle1);
+			//Submitted here instead of at the end of the frame so the zone measures the draws
+			renderer.submit();
+		}
+	});
 
-	glfwTerminate();
 	return 0;
 }
\ No newline at end of file
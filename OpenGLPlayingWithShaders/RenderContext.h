@@ -0,0 +1,321 @@
+#ifndef RENDERCONTEXT_H
+
+#define RENDERCONTEXT_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+//Where the render loop draws: a GLFW window, or an offscreen framebuffer with no window at all.
+//Headless mode is picked at runtime with --headless (or GL_HEADLESS=1 in the environment), so the
+//same executable runs on a desktop and on a build server without a display or GPU.
+//On Linux it uses an EGL context on the Mesa surfaceless platform (llvmpipe works), elsewhere it falls
+//back to an invisible GLFW window. Either way everything is drawn into an FBO the size of the window.
+//Headless runs stop after --frames N frames and the clock advances 1/60s per frame, so every run renders
+//exactly the same images. --capture file.ppm saves the last frame for image comparisons.
+//The solution only has Visual Studio projects, so there is no Linux build yet. One has to compile glad.c with
+//the sources and link glfw, EGL, dl and pthread (e.g. g++ -std=c++14 X.cpp glad.c -lglfw -lEGL -ldl -pthread).
+class RenderContext {
+public:
+	//NULL when headless
+	GLFWwindow* window = NULL;
+	int width = 0;
+	int height = 0;
+	//Offscreen target in headless mode, 0 (the window) otherwise
+	unsigned int framebuffer = 0;
+	//Frames finished so far
+	unsigned int frame = 0;
+
+	//Call before create()
+	void parseArguments(int argc, char** argv) {
+		const char* env = getenv("GL_HEADLESS");
+		if (env != NULL && strcmp(env, "0") != 0) {
+			headless = true;
+		}
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			if (arg == "--headless") {
+				headless = true;
+			}
+			else if (arg == "--frames" && i + 1 < argc) {
+				maxFrames = (unsigned int)strtoul(argv[++i], NULL, 10);
+			}
+			else if (arg == "--capture" && i + 1 < argc) {
+				capturePath = argv[++i];
+			}
+		}
+	}
+
+	//Call before create(), overrides what parseArguments() found
+	void setHeadless(bool headless) {
+		this->headless = headless;
+	}
+
+	bool isHeadless() const {
+		return headless;
+	}
+
+	//What --frames and --capture asked for, for loops that don't render through this context
+	unsigned int getMaxFrames() const {
+		return maxFrames;
+	}
+
+	const std::string& getCapturePath() const {
+		return capturePath;
+	}
+
+	//Creates the context, makes it current and loads GLAD. Prints why and returns false on failure
+	bool create(const char* title, int width, int height) {
+		this->width = width;
+		this->height = height;
+		if (headless) {
+#if defined(__linux__)
+			if (createEGL()) {
+				return loadGL(getEGLProcAddress) && createFramebuffer();
+			}
+			std::cout << "EGL surfaceless context failed, trying a hidden GLFW window" << std::endl;
+#endif
+		}
+
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		if (headless) {
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		}
+		window = glfwCreateWindow(width, height, title, NULL, NULL);
+		//Checks if window is not created, print message, terminate glfw.
+		if (window == NULL) {
+			std::cout << "Failed to create GLFW window" << std::endl;
+			glfwTerminate();
+			return false;
+		}
+		glfwMakeContextCurrent(window);
+		if (!loadGL((GLADloadproc)glfwGetProcAddress)) {
+			return false;
+		}
+		return !headless || createFramebuffer();
+	}
+
+	//The loader to hand to anything that loads GL functions itself (ShaderCache, StreamBuffer...)
+	GLADloadproc loader() const {
+		return usingEGL ? getEGLProcAddress : (GLADloadproc)glfwGetProcAddress;
+	}
+
+	//No-op when headless, the framebuffer never changes size
+	void setFramebufferSizeCallback(GLFWframebuffersizefun callback) {
+		if (window != NULL && !headless) {
+			glfwSetFramebufferSizeCallback(window, callback);
+		}
+	}
+
+	bool isRunning() const {
+		if (headless) {
+			return frame < maxFrames;
+		}
+		return !glfwWindowShouldClose(window);
+	}
+
+	bool isKeyPressed(int key) const {
+		return window != NULL && !headless && glfwGetKey(window, key) == GLFW_PRESS;
+	}
+
+	void close() {
+		if (headless) {
+			maxFrames = frame;
+		}
+		else {
+			glfwSetWindowShouldClose(window, true);
+		}
+	}
+
+	//Seconds since start, a fixed 60 steps per second when headless so runs are reproducible
+	double getTime() const {
+		if (headless) {
+			return frame / 60.0;
+		}
+		return glfwGetTime();
+	}
+
+	//Replaces glfwSwapBuffers + glfwPollEvents at the end of the render loop
+	void endFrame() {
+		present();
+		pollEvents();
+	}
+
+	//The swap half of endFrame(), for loops that do something between presenting and reading input (FramePacer)
+	void present() {
+		frame++;
+		if (headless) {
+			if (frame == maxFrames && !capturePath.empty()) {
+				capture(capturePath.c_str());
+			}
+			return;
+		}
+		glfwSwapBuffers(window);
+	}
+
+	void pollEvents() {
+		if (window != NULL) {
+			glfwPollEvents();
+		}
+	}
+
+	//Writes the current color buffer as a binary PPM
+	bool capture(const char* path) const {
+		std::vector<unsigned char> pixels((size_t)width * height * 3);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+		FILE* file = fopen(path, "wb");
+		if (file == NULL) {
+			std::cout << "ERROR::RENDER_CONTEXT::CAPTURE_FAILED\n" << path << std::endl;
+			return false;
+		}
+		fprintf(file, "P6\n%d %d\n255\n", width, height);
+		//GL rows start at the bottom, PPM rows at the top
+		for (int y = height - 1; y >= 0; y--) {
+			fwrite(pixels.data() + (size_t)y * width * 3, 1, (size_t)width * 3, file);
+		}
+		fclose(file);
+		return true;
+	}
+
+	//Replaces glfwTerminate
+	void destroy() {
+		//The offscreen target has to go while its context is still current
+		if (framebuffer != 0) {
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glDeleteFramebuffers(1, &framebuffer);
+			glDeleteRenderbuffers(2, renderbuffers);
+			framebuffer = 0;
+		}
+#if defined(__linux__)
+		if (usingEGL) {
+			eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			eglDestroyContext(eglDisplay, eglContext);
+			eglTerminate(eglDisplay);
+			usingEGL = false;
+			return;
+		}
+#endif
+		glfwTerminate();
+		window = NULL;
+	}
+
+private:
+	bool headless = false;
+	//Color and depth/stencil of the headless framebuffer
+	unsigned int renderbuffers[2] = { 0, 0 };
+	unsigned int maxFrames = 300;
+	std::string capturePath;
+	bool usingEGL = false;
+#if defined(__linux__)
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+	EGLContext eglContext = EGL_NO_CONTEXT;
+
+	bool createEGL() {
+		//Client extensions are queried without a display
+		const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (clientExtensions != NULL && strstr(clientExtensions, "EGL_MESA_platform_surfaceless") != NULL && getPlatformDisplay != NULL) {
+			eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		}
+		else {
+			eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		}
+		if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, NULL, NULL)) {
+			return false;
+		}
+		const char* extensions = eglQueryString(eglDisplay, EGL_EXTENSIONS);
+		if (extensions == NULL || strstr(extensions, "EGL_KHR_surfaceless_context") == NULL || !eglBindAPI(EGL_OPENGL_API)) {
+			eglTerminate(eglDisplay);
+			return false;
+		}
+
+		const EGLint configAttributes[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint configCount = 0;
+		if (!eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount) || configCount == 0) {
+			eglTerminate(eglDisplay);
+			return false;
+		}
+		//Same 3.3 core profile the GLFW window asks for
+		const EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+			EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+			EGL_NONE
+		};
+		eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+		if (eglContext == EGL_NO_CONTEXT || !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext)) {
+			eglTerminate(eglDisplay);
+			return false;
+		}
+		usingEGL = true;
+		return true;
+	}
+#endif
+
+	static void* getEGLProcAddress(const char* name) {
+#if defined(__linux__)
+		return (void*)eglGetProcAddress(name);
+#else
+		return NULL;
+#endif
+	}
+
+	bool loadGL(GLADloadproc load) {
+		//Load GLAD, with the context passing the address of the OpenGL functions for it to load
+		if (!gladLoadGLLoader(load)) {
+			std::cout << "Failed to initiate GLAD" << std::endl;
+			destroy();
+			return false;
+		}
+		return true;
+	}
+
+	//Without a window there is no default framebuffer to draw to, so draw into our own
+	bool createFramebuffer() {
+		glGenFramebuffers(1, &framebuffer);
+		glGenRenderbuffers(2, renderbuffers);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::RENDER_CONTEXT::FRAMEBUFFER_INCOMPLETE" << std::endl;
+			destroy();
+			return false;
+		}
+		//A surfaceless context starts with an empty viewport
+		glViewport(0, 0, width, height);
+		return true;
+	}
+};
+
+#endif // !RENDERCONTEXT_H
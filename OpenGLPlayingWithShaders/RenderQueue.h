@@ -0,0 +1,146 @@
+#ifndef RENDERQUEUE_H
+
+#define RENDERQUEUE_H
+
+#include "DrawCommand.h"
+
+#include <vector>
+#include <cstdint>
+
+//Draws recorded by one job of Renderer::record, merged into the RenderQueue afterwards.
+//Recording only fills a vector, so any thread can do it.
+class CommandList {
+public:
+	std::vector<DrawCommand> commands;
+
+	//The reference is only valid until the next draw(), chain the setters on it and let it go
+	DrawCommand& draw(unsigned int program, const Mesh& mesh) {
+		commands.push_back(DrawCommand::make(program, mesh));
+		return commands.back();
+	}
+
+	void clear() {
+		commands.clear();
+	}
+};
+
+//The draws of one frame, recorded in any order and handed back sorted by a 64-bit key so draws that share
+//a program, VAO and material end up next to each other (fewer state changes, longer merged runs).
+//Key layout, most significant first:
+//	pass		4 bits	lower passes are drawn first, the only thing that guarantees order between draws
+//	program		12 bits
+//	vertexArray	12 bits
+//	material	16 bits
+//	depth		20 bits	0 near, 1 far. Front to back inside a state group, pass 1 - depth for back to front
+//Program and VAO use the low bits of the GL name, names past 4096 can share a group but are never merged
+//by mistake, merging still compares the full command. The sort is stable, equal keys keep recording order.
+class RenderQueue {
+public:
+	//false submits in recording order, to compare state changes with and without sorting
+	bool sorted = true;
+
+	//The reference is only valid until the next push() or append()
+	DrawCommand& push(const DrawCommand& command) {
+		commands.push_back(command);
+		return commands.back();
+	}
+
+	void append(const CommandList& list) {
+		commands.insert(commands.end(), list.commands.begin(), list.commands.end());
+	}
+
+	size_t size() const {
+		return commands.size();
+	}
+
+	bool empty() const {
+		return commands.empty();
+	}
+
+	//Only valid after sort(), index i is the i-th command to submit
+	const DrawCommand& operator[](size_t i) const {
+		return commands[order[i].index];
+	}
+
+	void clear() {
+		commands.clear();
+		order.clear();
+	}
+
+	static uint64_t makeKey(const DrawCommand& command) {
+		float depth = command.depth < 0.0f ? 0.0f : (command.depth > 1.0f ? 1.0f : command.depth);
+		uint64_t depthBits = (uint64_t)(depth * DEPTH_MAX) & DEPTH_MAX;
+		return ((uint64_t)(command.pass & 0xF) << 60)
+			| ((uint64_t)(command.program & 0xFFF) << 48)
+			| ((uint64_t)(command.vertexArray & 0xFFF) << 36)
+			| ((uint64_t)command.material << 20)
+			| depthBits;
+	}
+
+	//Builds the submission order, call once after recording and before indexing
+	void sort() {
+		order.resize(commands.size());
+		for (size_t i = 0; i < commands.size(); i++) {
+			order[i].key = sorted ? makeKey(commands[i]) : 0;
+			order[i].index = (uint32_t)i;
+		}
+		if (sorted && order.size() > 1) {
+			radixSort();
+		}
+	}
+
+private:
+	struct Entry {
+		uint64_t key;
+		uint32_t index;
+	};
+
+	static const uint64_t DEPTH_MAX = (1 << 20) - 1;
+
+	std::vector<DrawCommand> commands;
+	std::vector<Entry> order;
+	//Ping-pong buffer for the radix passes, kept so sorting doesn't allocate every frame
+	std::vector<Entry> scratch;
+
+	//LSD radix sort, one byte per pass. All eight histograms are counted in a single read, and a pass whose
+	//byte is the same for every key is skipped, so a frame with few programs and VAOs only pays for the
+	//bytes that actually differ.
+	void radixSort() {
+		const size_t count = order.size();
+		uint32_t histograms[8][256] = {};
+		for (size_t i = 0; i < count; i++) {
+			uint64_t key = order[i].key;
+			for (int byte = 0; byte < 8; byte++) {
+				histograms[byte][(key >> (byte * 8)) & 0xFF]++;
+			}
+		}
+
+		scratch.resize(count);
+		Entry* source = order.data();
+		Entry* destination = scratch.data();
+		for (int byte = 0; byte < 8; byte++) {
+			uint32_t* histogram = histograms[byte];
+			if (histogram[(source[0].key >> (byte * 8)) & 0xFF] == count) {
+				continue;
+			}
+			//Counts to starting offsets
+			uint32_t offset = 0;
+			for (int bucket = 0; bucket < 256; bucket++) {
+				uint32_t bucketCount = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucketCount;
+			}
+			for (size_t i = 0; i < count; i++) {
+				destination[histogram[(source[i].key >> (byte * 8)) & 0xFF]++] = source[i];
+			}
+			Entry* swap = source;
+			source = destination;
+			destination = swap;
+		}
+		if (source != order.data()) {
+			order.swap(scratch);
+		}
+	}
+};
+
+#endif // !RENDERQUEUE_H
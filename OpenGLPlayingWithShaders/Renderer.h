@@ -0,0 +1,421 @@
+#ifndef RENDERER_H
+
+#define RENDERER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "RenderContext.h"
+#include "GLStateCache.h"
+#include "GLHandles.h"
+#include "DrawCommand.h"
+#include "RenderQueue.h"
+#include "JobSystem.h"
+#include "FrameProfiler.h"
+#include "FramePacer.h"
+#include "VertexFormat.h"
+#include "VertexLayout.h"
+#include "IndexBuffer.h"
+
+#include <vector>
+#include <deque>
+#include <utility>
+#include <iostream>
+#include <cstdint>
+#include <string>
+#include <cstdlib>
+
+//The setup and frame loop every executable used to repeat: context creation, GLAD, resize handling,
+//shader compiling, VAO/VBO/EBO setup, clearing, input and buffer swaps.
+//Objects made through create*() are owned by the renderer and freed before the context is destroyed.
+//Draws recorded with draw() are queued, sorted by state (see RenderQueue) and submitted together at the end
+//of the frame through the state cache, with runs of compatible draws merged into one glMultiDraw* call.
+//Big frames can be recorded on every core with record(), only the thread that called init() talks to GL.
+//Declare the Renderer before any other GL object in main(), so everything else is destroyed while the
+//context still exists.
+class Renderer {
+public:
+	RenderContext context;
+	GLStateCache state;
+	FrameProfiler profiler;
+	FramePacer pacer;
+	//Workers for record(), --threads N (0, the default, uses every hardware thread)
+	JobSystem jobs;
+	float clearColor[4] = { 0.2f, 0.3f, 0.3f, 1.0f };
+	//Totals since init(), for printStats()
+	unsigned int commandsSubmitted = 0;
+	unsigned int drawCalls = 0;
+	//Times submit() changed program or VAO, what sorting tries to keep low
+	unsigned int programSwitches = 0;
+	unsigned int vertexArraySwitches = 0;
+
+	Renderer() {}
+	~Renderer() {
+		shutdown();
+	}
+	Renderer(const Renderer&) = delete;
+	Renderer& operator=(const Renderer&) = delete;
+
+	//Parses the command line (--headless, --frames, --capture, --trace, --unsorted, --threads and the FramePacer
+	//options), creates the context and loads GL
+	bool init(int argc, char** argv, const char* title, int width, int height) {
+		context.parseArguments(argc, argv);
+		profiler.parseArguments(argc, argv);
+		pacer.parseArguments(argc, argv);
+		unsigned int threads = 0;
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			if (arg == "--unsorted") {
+				queue.sorted = false;
+			}
+			else if (arg == "--threads" && i + 1 < argc) {
+				threads = (unsigned int)atoi(argv[++i]);
+			}
+		}
+		jobs.init(threads);
+		if (!context.create(title, width, height)) {
+			return false;
+		}
+		if (context.window != NULL) {
+			glfwSetWindowUserPointer(context.window, this);
+		}
+		context.setFramebufferSizeCallback(framebufferSizeCallback);
+		VertexAttribBinding::init(context.loader());
+		pacer.init(context.isHeadless() ? NULL : context.window);
+		initialized = true;
+		return true;
+	}
+
+	//Frees everything the renderer owns and destroys the context, the destructor calls it too
+	void shutdown() {
+		if (!initialized) {
+			return;
+		}
+		initialized = false;
+		jobs.shutdown();
+		programs.clear();
+		vertexArrays.clear();
+		buffers.clear();
+		indexBuffers.clear();
+		profiler.destroy();
+		pacer.destroy();
+		printStats();
+		profiler.writeChromeTrace();
+		context.destroy();
+	}
+
+	void printStats() const {
+		state.printStats();
+		unsigned int frames = context.frame > 0 ? context.frame : 1;
+		std::cout << "RENDERER: " << commandsSubmitted << " commands in " << drawCalls << " draw calls, "
+			<< (float)programSwitches / frames << " program and " << (float)vertexArraySwitches / frames
+			<< " VAO switches per frame (" << (queue.sorted ? "sorted" : "unsorted") << ")" << std::endl;
+		profiler.printStats();
+		pacer.printStats();
+	}
+
+	//Compiles and links a program the renderer owns, errors are printed with name. Returns the program
+	unsigned int createProgram(const char* vertexSource, const char* fragmentSource, const char* name) {
+		unsigned int vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource, name);
+		unsigned int fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource, name);
+		ProgramHandle program = ProgramHandle::create(&state);
+		glAttachShader(program.get(), vertexShader);
+		glAttachShader(program.get(), fragmentShader);
+		glLinkProgram(program.get());
+
+		int success;
+		glGetProgramiv(program.get(), GL_LINK_STATUS, &success);
+		if (!success) {
+			char infoLog[512];
+			glGetProgramInfoLog(program.get(), 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::" << name << "::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		}
+		//Linked programs keep their own copy, the shaders aren't needed anymore
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return adoptProgram(program.release());
+	}
+
+	//Hands a program made elsewhere (e.g. by ShaderCompiler) to the renderer to free
+	unsigned int adoptProgram(unsigned int program) {
+		programs.push_back(ProgramHandle::adopt(program, &state));
+		return program;
+	}
+
+	//Uploads vertices (and optionally indices) into a new VAO the renderer owns. Indices are stored as the smallest
+	//type the vertex count allows, see IndexBuffer
+	Mesh createMesh(const void* vertices, unsigned int vertexCount, unsigned int stride, const unsigned int* indices,
+		unsigned int indexCount, const std::vector<VertexAttribute>& attributes) {
+		return uploadMesh(vertices, vertexCount, stride, indices, indexCount, [&](unsigned int vertexBuffer) {
+			state.bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+			for (const VertexAttribute& attribute : attributes) {
+				glVertexAttribPointer(attribute.index, attribute.size, attribute.type, attribute.normalized ? GL_TRUE : GL_FALSE,
+					(GLsizei)stride, (void*)(uintptr_t)attribute.offset);
+				glEnableVertexAttribArray(attribute.index);
+			}
+		});
+	}
+
+	//Same with a VertexLayout, vertices holds vertexCount vertices of Layout::stride bytes
+	template <typename Layout>
+	Mesh createMesh(const void* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount) {
+		return uploadMesh(vertices, vertexCount, Layout::stride, indices, indexCount, [&](unsigned int vertexBuffer) {
+			Layout::apply(state, vertexBuffer);
+		});
+	}
+
+	//Same with indices already packed as indexType (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT), uploaded as they are, e.g.
+	//straight from a MeshFile's mapping
+	Mesh createMesh(const void* vertices, unsigned int vertexCount, unsigned int stride, const void* indices,
+		unsigned int indexCount, GLenum indexType, const std::vector<VertexAttribute>& attributes) {
+		Mesh mesh = createMesh(vertices, vertexCount, stride, NULL, 0, attributes);
+		if (indices != NULL) {
+			BufferHandle indexBuffer = BufferHandle::create(&state);
+			state.bindVertexArray(mesh.vertexArray);
+			state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.get());
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCount * indexTypeSize(indexType), indices, GL_STATIC_DRAW);
+			state.bindVertexArray(0);
+			mesh.count = (GLsizei)indexCount;
+			mesh.indexed = true;
+			mesh.indexType = indexType;
+			buffers.push_back(std::move(indexBuffer));
+		}
+		return mesh;
+	}
+
+	//Handles input and clears the screen, returns false once the loop should stop
+	bool beginFrame() {
+		if (context.isKeyPressed(GLFW_KEY_ESCAPE)) {
+			context.close();
+		}
+		if (!context.isRunning()) {
+			return false;
+		}
+		profiler.beginFrame();
+		state.clearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+		glClear(GL_COLOR_BUFFER_BIT);
+		return true;
+	}
+
+	//Submits the queued draws and presents the frame, then waits as long as the pacer asks before reading the
+	//input for the next one, so that input is as fresh as possible
+	void endFrame() {
+		submit();
+		profiler.endFrame();
+		context.present();
+		pacer.frameSubmitted();
+		pacer.throttle();
+		context.pollEvents();
+		pacer.frameStart();
+	}
+
+	//Runs frame() once per frame until the window closes (or the headless frame count is reached)
+	template <typename FrameFunction>
+	void run(FrameFunction frame) {
+		while (beginFrame()) {
+			frame();
+			endFrame();
+		}
+	}
+
+	//Queues a draw. The returned reference is for chaining setters (setColor, setPass, setDepth...) right away:
+	//the queue is a vector, so the next draw() may move the command and leave the reference dangling
+	DrawCommand& draw(unsigned int program, const Mesh& mesh) {
+		return queue.push(DrawCommand::make(program, mesh));
+	}
+
+	//Calls recordItem(list, i) for every i in [0, count) spread over the job threads, for scenes big enough
+	//that building the frame (culling, picking meshes, packing uniforms) is the slow part. recordItem must
+	//not call GL and may only write to its own list. Lists are merged in item order, so the result doesn't
+	//depend on which thread ran what.
+	template <typename RecordFunction>
+	void record(unsigned int count, RecordFunction recordItem) {
+		//A few chunks per thread so stealing can even out uneven items
+		unsigned int grain = count / (jobs.threadCount() * 4);
+		if (grain < 64) {
+			grain = 64;
+		}
+		unsigned int chunks = (count + grain - 1) / grain;
+		if (lists.size() < chunks) {
+			lists.resize(chunks);
+		}
+		jobs.parallelFor(count, grain, [&](unsigned int begin, unsigned int end) {
+			CommandList& list = lists[begin / grain];
+			list.clear();
+			for (unsigned int i = begin; i < end; i++) {
+				recordItem(list, i);
+			}
+		});
+		for (unsigned int chunk = 0; chunk < chunks; chunk++) {
+			queue.append(lists[chunk]);
+		}
+	}
+
+	//Sorts and issues everything queued so far, endFrame() calls it. GL calls made directly in between
+	//draw() and submit() run before the queued draws.
+	void submit() {
+		queue.sort();
+		unsigned int currentProgram = 0;
+		unsigned int currentVertexArray = 0;
+		size_t i = 0;
+		while (i < queue.size()) {
+			const DrawCommand& command = queue[i];
+			size_t end = i + 1;
+			while (end < queue.size() && queue[end].canMergeWith(command)) {
+				end++;
+			}
+			if (i == 0 || command.program != currentProgram) {
+				programSwitches++;
+				currentProgram = command.program;
+			}
+			if (i == 0 || command.vertexArray != currentVertexArray) {
+				vertexArraySwitches++;
+				currentVertexArray = command.vertexArray;
+			}
+			state.useProgram(command.program);
+			if (command.colorLocation != -1) {
+				glUniform4fv(command.colorLocation, 1, command.color);
+			}
+			state.bindVertexArray(command.vertexArray);
+			//Split meshes always go through glMultiDraw*, one entry per chunk
+			if (end - i == 1 && (command.chunks == NULL || command.instanceCount != 1)) {
+				drawSingle(command);
+			}
+			else {
+				drawMerged(i, end);
+			}
+			drawCalls++;
+			i = end;
+		}
+		commandsSubmitted += (unsigned int)queue.size();
+		queue.clear();
+	}
+
+private:
+	bool initialized = false;
+	std::vector<ProgramHandle> programs;
+	std::vector<VertexArrayHandle> vertexArrays;
+	std::vector<BufferHandle> buffers;
+	std::deque<IndexBuffer> indexBuffers;
+	RenderQueue queue;
+	//One per record() chunk, kept between frames so recording doesn't allocate
+	std::vector<CommandList> lists;
+	//Scratch arrays for glMultiDraw*, kept around so submitting doesn't allocate
+	std::vector<GLsizei> counts;
+	std::vector<GLint> firsts;
+	std::vector<const void*> offsets;
+	std::vector<GLint> baseVertices;
+
+	//setupAttributes(vertexBuffer) describes the vertices to the VAO, which is bound when it runs
+	template <typename SetupFunction>
+	Mesh uploadMesh(const void* vertices, unsigned int vertexCount, unsigned int stride, const unsigned int* indices,
+		unsigned int indexCount, SetupFunction setupAttributes) {
+		VertexArrayHandle vertexArray = VertexArrayHandle::create(&state);
+		BufferHandle vertexBuffer = BufferHandle::create(&state);
+		state.bindVertexArray(vertexArray.get());
+		state.bindBuffer(GL_ARRAY_BUFFER, vertexBuffer.get());
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCount * stride, vertices, GL_STATIC_DRAW);
+		setupAttributes(vertexBuffer.get());
+
+		Mesh mesh = { vertexArray.get(), (GLsizei)vertexCount, 0, 0, false, GL_UNSIGNED_INT, NULL, 0 };
+		if (indices != NULL) {
+			BufferHandle indexBuffer = BufferHandle::create(&state);
+			//Kept for the chunks of split meshes
+			indexBuffers.emplace_back();
+			IndexBuffer& indexData = indexBuffers.back();
+			indexData.addMesh(indices, indexCount, 0);
+			indexData.upload(state, indexBuffer.get());
+			mesh = indexData.getMesh(vertexArray.get(), 0);
+			buffers.push_back(std::move(indexBuffer));
+		}
+		state.bindVertexArray(0);
+		vertexArrays.push_back(std::move(vertexArray));
+		buffers.push_back(std::move(vertexBuffer));
+		return mesh;
+	}
+
+	static void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
+		Renderer* renderer = (Renderer*)glfwGetWindowUserPointer(window);
+		renderer->state.viewport(0, 0, width, height);
+	}
+
+	static unsigned int compileShader(GLenum type, const char* source, const char* name) {
+		unsigned int shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+		int success;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success) {
+			char infoLog[512];
+			glGetShaderInfoLog(shader, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::" << name << (type == GL_VERTEX_SHADER ? "::VERTEX" : "::FRAGMENT")
+				<< "::COMPILATION_FAILED\n" << infoLog << std::endl;
+		}
+		return shader;
+	}
+
+	static const void* indexOffset(const DrawCommand& command, unsigned int first) {
+		return (const void*)(uintptr_t)(first * indexTypeSize(command.indexType));
+	}
+
+	static void drawSingle(const DrawCommand& command) {
+		if (command.indexed) {
+			if (command.chunks != NULL) {
+				//Instanced and split, there is no instanced multi-draw in GL 3.3
+				for (unsigned int c = 0; c < command.chunkCount; c++) {
+					const MeshChunk& chunk = command.chunks[c];
+					glDrawElementsInstancedBaseVertex(GL_TRIANGLES, chunk.count, command.indexType, indexOffset(command, chunk.first),
+						command.instanceCount, chunk.baseVertex);
+				}
+			}
+			else if (command.instanceCount != 1) {
+				glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, command.indexType, indexOffset(command, command.first),
+					command.instanceCount, command.baseVertex);
+			}
+			else {
+				glDrawElementsBaseVertex(GL_TRIANGLES, command.count, command.indexType, indexOffset(command, command.first), command.baseVertex);
+			}
+		}
+		else if (command.instanceCount != 1) {
+			glDrawArraysInstanced(GL_TRIANGLES, (GLint)command.first, command.count, command.instanceCount);
+		}
+		else {
+			glDrawArrays(GL_TRIANGLES, (GLint)command.first, command.count);
+		}
+	}
+
+	void drawMerged(size_t begin, size_t end) {
+		counts.clear();
+		firsts.clear();
+		offsets.clear();
+		baseVertices.clear();
+		for (size_t i = begin; i < end; i++) {
+			const DrawCommand& command = queue[i];
+			if (command.chunks != NULL) {
+				for (unsigned int c = 0; c < command.chunkCount; c++) {
+					const MeshChunk& chunk = command.chunks[c];
+					counts.push_back(chunk.count);
+					offsets.push_back(indexOffset(command, chunk.first));
+					baseVertices.push_back(chunk.baseVertex);
+				}
+				continue;
+			}
+			counts.push_back(command.count);
+			if (command.indexed) {
+				offsets.push_back(indexOffset(command, command.first));
+				baseVertices.push_back(command.baseVertex);
+			}
+			else {
+				firsts.push_back((GLint)command.first);
+			}
+		}
+		if (queue[begin].indexed) {
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), queue[begin].indexType,
+				(const void* const*)offsets.data(), (GLsizei)counts.size(), baseVertices.data());
+		}
+		else {
+			glMultiDrawArrays(GL_TRIANGLES, firsts.data(), counts.data(), (GLsizei)counts.size());
+		}
+	}
+};
+
+#endif // !RENDERER_H
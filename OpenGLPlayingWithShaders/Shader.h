@@ -3,105 +3,343 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include "ShaderCache.h"
+#include "MappedFile.h"
+#include "GLStateCache.h"
 
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <vector>
+#include <map>
+#include <utility>
 #include <iostream>
+#include <cstdint>
+#include <chrono>
+
+//FNV-1a hash, constexpr so uniform names can be hashed at compile time
+constexpr uint32_t hashUniformName(const char* name, size_t length) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++) {
+		hash = (hash ^ (uint32_t)(unsigned char)name[i]) * 16777619u;
+	}
+	return hash;
+}
+
+constexpr size_t uniformNameLength(const char* name) {
+	size_t length = 0;
+	while (name[length] != '\0') {
+		length++;
+	}
+	return length;
+}
+
+//Pre-hashed uniform name, only the hash is kept. Only a constexpr handle is guaranteed to be hashed at compile time:
+//	constexpr UniformHandle customColor("customColor");
+//A literal passed straight to a setter builds a temporary handle and is hashed on every call
+struct UniformHandle {
+	uint32_t hash;
+
+	constexpr UniformHandle(const char* str) : hash(hashUniformName(str, uniformNameLength(str))) {}
+	UniformHandle(const std::string& str) : hash(hashUniformName(str.c_str(), str.size())) {}
+};
+
+class Shader;
+
+//Told when a Shader it keeps a pointer to moves (to is the new address) or is destroyed (to is NULL),
+//so the pointer never dangles. ShaderWatcher is one
+class ShaderObserver {
+public:
+	virtual void shaderMoved(Shader* from, Shader* to) = 0;
+
+protected:
+	~ShaderObserver() {}
+};
 
 class Shader {
 public:
 	unsigned int ID;
+	std::string vertexPath;
+	std::string fragmentPath;
 
-	Shader(const char* vertexPath, const char* fragmentPath) {
-		//Declare vars
-		std::string vertexCode;
-		std::string fragmentCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-		//Check for exceptions
-		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		try {
-			//open the files
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
-			//read files buffer contents into streams
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			//close file handlers
-			vShaderFile.close();
-			fShaderFile.close();
-			//convert the stream into string
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
+	//Pass a ShaderCache to reuse the linked binary from a previous run instead of compiling
+	Shader(const char* vertexPath, const char* fragmentPath, ShaderCache* cache = NULL) {
+		//Step 1: Read the sources, the paths are kept so the shader can be reloaded later
+		this->vertexPath = vertexPath;
+		this->fragmentPath = fragmentPath;
+		//The files are mapped and handed to GL with explicit lengths, so the source is never copied on our side
+		MappedFile vertexFile(vertexPath);
+		MappedFile fragmentFile(fragmentPath);
+		if (!vertexFile.isOpen() || !fragmentFile.isOpen()) {
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+		}
+		build(vertexFile.data(), vertexFile.size(), fragmentFile.data(), fragmentFile.size(), cache);
+	}
 
+	//Builds from sources already in memory (e.g. ShaderPreprocessor output), these can't be hot reloaded
+	Shader(const std::string& vertexCode, const std::string& fragmentCode, ShaderCache* cache) {
+		build(vertexCode.data(), vertexCode.size(), fragmentCode.data(), fragmentCode.size(), cache);
+	}
+
+	//The program is deleted with the Shader, so Shaders move but don't copy
+	~Shader() {
+		if (observer != NULL) {
+			observer->shaderMoved(this, NULL);
 		}
-		catch (std::ifstream::failure e) {
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+		if (ID != 0) {
+			glDeleteProgram(ID);
+		}
+	}
+
+	Shader(Shader&& other) noexcept : ID(other.ID), vertexPath(std::move(other.vertexPath)), fragmentPath(std::move(other.fragmentPath)),
+		uniformSlots(std::move(other.uniformSlots)), observer(other.observer) {
+		other.ID = 0;
+		other.observer = NULL;
+		if (observer != NULL) {
+			observer->shaderMoved(&other, this);
+		}
+	}
+
+	Shader& operator=(Shader&& other) noexcept {
+		if (this != &other) {
+			//The program this Shader was is gone, whoever watched it stops
+			if (observer != NULL) {
+				observer->shaderMoved(this, NULL);
+			}
+			if (ID != 0) {
+				glDeleteProgram(ID);
+			}
+			ID = other.ID;
+			vertexPath = std::move(other.vertexPath);
+			fragmentPath = std::move(other.fragmentPath);
+			uniformSlots = std::move(other.uniformSlots);
+			observer = other.observer;
+			other.ID = 0;
+			other.observer = NULL;
+			if (observer != NULL) {
+				observer->shaderMoved(&other, this);
+			}
+		}
+		return *this;
+	}
+
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+
+	void use() {
+		glUseProgram(ID);
+	}
+
+	//Skips glUseProgram if this program is already current
+	void use(GLStateCache& state) {
+		state.useProgram(ID);
+	}
+
+	//Replaces the program with an already linked one (used by hot reload), the old program is deleted.
+	//Pass the GLStateCache it is drawn through: the driver may hand the old name to the new program, and a cache
+	//still holding it would skip the glUseProgram
+	void swapProgram(unsigned int newID, GLStateCache* state = NULL) {
+		glDeleteProgram(ID);
+		if (state != NULL) {
+			state->onDeleteProgram(ID);
+		}
+		ID = newID;
+		cacheUniforms();
+	}
+
+	//One observer at a time, NULL to stop
+	void setObserver(ShaderObserver* newObserver) {
+		observer = newObserver;
+	}
+
+	//Returns -1 if the program has no active uniform with that name, same as glGetUniformLocation.
+	//Only the hash is compared, active uniforms whose hashes collide are reported when the program is linked
+	int getLocation(const UniformHandle& uniform) const {
+		size_t mask = uniformSlots.size() - 1;
+		for (size_t i = uniform.hash & mask; ; i = (i + 1) & mask) {
+			const UniformSlot& slot = uniformSlots[i];
+			if (slot.location == -1 || slot.hash == uniform.hash) {
+				return slot.location;
+			}
+		}
+	}
+
+	void setBool(const UniformHandle& uniform, bool value) const {
+		glUniform1i(getLocation(uniform), (int)value);
+	}
+	void setInt(const UniformHandle& uniform, int value) const {
+		glUniform1i(getLocation(uniform), value);
+	}
+	void setFloat(const UniformHandle& uniform, float value) const {
+		glUniform1f(getLocation(uniform), value);
+	}
+	void setVec4(const UniformHandle& uniform, float x, float y, float z, float w) const {
+		glUniform4f(getLocation(uniform), x, y, z, w);
+	}
+
+	//Every program linked after this points its block with that name at binding (see UniformBlock.h).
+	//size is the C++ struct size, checked against the GLSL block so layout mistakes show up on link
+	static void registerUniformBlock(const std::string& blockName, unsigned int binding, size_t size) {
+		uniformBlocks()[blockName] = UniformBlockBinding{ binding, size };
+	}
+
+	//Points every registered block this program declares at its binding, already done after linking.
+	//Only needed for programs linked before the block was registered
+	void bindUniformBlocks() const {
+		int count = 0, maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+		std::vector<char> name(maxLength > 0 ? maxLength : 1);
+		for (int i = 0; i < count; i++) {
+			glGetActiveUniformBlockName(ID, (GLuint)i, (GLsizei)name.size(), NULL, name.data());
+			std::map<std::string, UniformBlockBinding>::const_iterator block = uniformBlocks().find(name.data());
+			if (block == uniformBlocks().end()) {
+				continue;
+			}
+			int size = 0;
+			glGetActiveUniformBlockiv(ID, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+			if ((size_t)size > block->second.size) {
+				std::cout << "ERROR::SHADER::UNIFORM_BLOCK::SIZE_MISMATCH\n" << name.data() << " is " << size
+					<< " bytes in GLSL, " << block->second.size << " in C++" << std::endl;
+			}
+			glUniformBlockBinding(ID, (GLuint)i, block->second.binding);
+		}
+	}
+
+private:
+	struct UniformSlot {
+		uint32_t hash;
+		int location;
+	};
+	//Open addressing table indexed by the name hash, size is always a power of two with at least one free slot
+	std::vector<UniformSlot> uniformSlots;
+	ShaderObserver* observer = NULL;
+
+	struct UniformBlockBinding {
+		unsigned int binding;
+		size_t size;
+	};
+	//Shared by every Shader, a function static so the header can define it
+	static std::map<std::string, UniformBlockBinding>& uniformBlocks() {
+		static std::map<std::string, UniformBlockBinding> blocks;
+		return blocks;
+	}
+
+	void build(const char* vertexCode, size_t vertexLength, const char* fragmentCode, size_t fragmentLength, ShaderCache* cache) {
+		//Step 2: Try the program binary cache, a hit skips compiling and linking entirely
+		ID = glCreateProgram();
+		uint64_t cacheKey = 0;
+		if (cache != NULL && cache->isEnabled()) {
+			cacheKey = cache->makeKey(vertexCode, vertexLength, fragmentCode, fragmentLength, "");
+			if (cache->load(ID, cacheKey)) {
+				cacheUniforms();
+				return;
+			}
 		}
-		const char* vShaderCode = vertexCode.c_str();
-		const char* fShaderCode = fragmentCode.c_str();
+		auto compileStart = std::chrono::steady_clock::now();
+
+		GLint vShaderLength = (GLint)vertexLength;
+		GLint fShaderLength = (GLint)fragmentLength;
 
-		//Step 2: Compile Shaders
+		//Step 3: Compile Shaders
 		unsigned int vertex, fragment;
 		int success;
 		char infoLog[512];
 
 		//Vertex shader
 		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
+		glShaderSource(vertex, 1, &vertexCode, &vShaderLength);
 		glCompileShader(vertex);
-		// print compile errors if any
-		glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-		if (!success)
-		{
-			glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-		};
 
 		//Fragment shader
 		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
+		glShaderSource(fragment, 1, &fragmentCode, &fShaderLength);
 		glCompileShader(fragment);
-		// print compile errors if any
-		glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-		if (!success)
-		{
-			glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-		};
+		//Compile status is only queried if linking fails, querying it right away would make the driver
+		//finish each compile before the next one is even submitted
 
 		//shader Program
-		ID = glCreateProgram();
 		glAttachShader(ID, vertex);
 		glAttachShader(ID, fragment);
+		if (cache != NULL) {
+			cache->prepareProgram(ID);
+		}
 		glLinkProgram(ID);
 		// print linking errors if any
 		glGetProgramiv(ID, GL_LINK_STATUS, &success);
 		if (!success)
 		{
+			// print compile errors if any
+			glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+			if (!success)
+			{
+				glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+				std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+			}
+			glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+			if (!success)
+			{
+				glGetShaderInfoLog(fragment, 512, NULL, infoLog);
+				std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+			}
 			glGetProgramInfoLog(ID, 512, NULL, infoLog);
 			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 		}
+		else if (cache != NULL) {
+			double compileTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compileStart).count();
+			cache->store(ID, cacheKey, compileTime);
+		}
 
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
-	};
 
-	void use() {
-		glUseProgram(ID);
+		cacheUniforms();
 	}
 
-	void setBool(const std::string& name, bool value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
-	}
-	void setInt(const std::string& name, int value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	//Query every active uniform once after linking, so setters never ask the driver for locations
+	void cacheUniforms() {
+		int count = 0, maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+		size_t size = 1;
+		while (size < (size_t)count * 2 + 1) {
+			size <<= 1;
+		}
+		uniformSlots.assign(size, UniformSlot{ 0, -1 });
+
+		std::vector<char> name(maxLength > 0 ? maxLength : 1);
+		for (int i = 0; i < count; i++) {
+			int length = 0, arraySize = 0;
+			GLenum type;
+			glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &arraySize, &type, name.data());
+			int location = glGetUniformLocation(ID, name.data());
+			//Uniforms inside blocks have no location
+			if (location == -1) {
+				continue;
+			}
+			insertUniform(name.data(), (size_t)length, location);
+			//Arrays are reported as "name[0]", also allow them to be set by the plain name
+			if (length > 3 && std::string(name.data() + length - 3) == "[0]") {
+				insertUniform(name.data(), (size_t)length - 3, location);
+			}
+		}
+		//Block bindings are program state too, so they have to be set again on every (re)link
+		bindUniformBlocks();
 	}
-	void setFloat(const std::string& name, float value) const {
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+
+	void insertUniform(const char* name, size_t length, int location) {
+		uint32_t hash = hashUniformName(name, length);
+		size_t mask = uniformSlots.size() - 1;
+		size_t i = hash & mask;
+		while (uniformSlots[i].location != -1) {
+			//Two active names with the same hash can't be told apart by the setters, the first one keeps the hash
+			if (uniformSlots[i].hash == hash) {
+				std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION\n" << std::string(name, length)
+					<< " can't be set by name, rename it" << std::endl;
+				return;
+			}
+			i = (i + 1) & mask;
+		}
+		uniformSlots[i] = UniformSlot{ hash, location };
 	}
 };
 
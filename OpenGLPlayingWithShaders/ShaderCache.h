@@ -0,0 +1,207 @@
+#ifndef SHADERCACHE_H
+
+#define SHADERCACHE_H
+
+#include <glad/glad.h>
+#include "GLExtensions.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+//GLAD is generated for core 3.3 only, so the ARB_get_program_binary bits are declared here
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+typedef void (APIENTRYP PFNCACHEGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNCACHEPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNCACHEPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+//On-disk cache of linked program binaries.
+//Entries are keyed by the shader sources, the defines and the driver strings, so a driver update
+//or a shader edit simply misses and the program is compiled from source again.
+class ShaderCache {
+public:
+	unsigned int hits = 0;
+	unsigned int misses = 0;
+	//Binaries the driver refused (usually after a driver update), these count as misses too
+	unsigned int rejected = 0;
+	//Sum of (recorded compile time - load time) over every hit
+	double millisecondsSaved = 0.0;
+
+	ShaderCache(const char* directory) : directory(directory) {}
+
+	//Call after gladLoadGLLoader, with the same loader
+	bool init(GLADloadproc load) {
+		enabled = false;
+		if (!hasGLVersion(4, 1) && !hasGLExtension("GL_ARB_get_program_binary")) {
+			std::cout << "WARNING::SHADER_CACHE::PROGRAM_BINARY_NOT_SUPPORTED" << std::endl;
+			return false;
+		}
+		getProgramBinary = (PFNCACHEGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+		programBinary = (PFNCACHEPROGRAMBINARYPROC)load("glProgramBinary");
+		programParameteri = (PFNCACHEPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+		int formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		if (getProgramBinary == NULL || programBinary == NULL || formats == 0) {
+			std::cout << "WARNING::SHADER_CACHE::NO_PROGRAM_BINARY_FORMATS" << std::endl;
+			return false;
+		}
+		driver = std::string((const char*)glGetString(GL_VENDOR)) + "|"
+			+ (const char*)glGetString(GL_RENDERER) + "|"
+			+ (const char*)glGetString(GL_VERSION);
+#ifdef _WIN32
+		_mkdir(this->directory.c_str());
+#else
+		mkdir(this->directory.c_str(), 0755);
+#endif
+		enabled = true;
+		return true;
+	}
+
+	bool isEnabled() const {
+		return enabled;
+	}
+
+	uint64_t makeKey(const char* vertexCode, size_t vertexLength, const char* fragmentCode, size_t fragmentLength, const std::string& defines) const {
+		uint64_t hash = 14695981039346656037ull;
+		hashBytes(hash, driver.data(), driver.size());
+		hashBytes(hash, defines.data(), defines.size());
+		hashBytes(hash, vertexCode, vertexLength);
+		hashBytes(hash, fragmentCode, fragmentLength);
+		return hash;
+	}
+
+	//Must be set before glLinkProgram, otherwise some drivers won't keep a retrievable binary
+	void prepareProgram(unsigned int program) const {
+		if (enabled && programParameteri != NULL) {
+			programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+	}
+
+	//Returns true if program now holds a linked binary from the cache
+	bool load(unsigned int program, uint64_t key) {
+		if (!enabled) {
+			return false;
+		}
+		auto start = std::chrono::steady_clock::now();
+
+		std::ifstream file(entryPath(key), std::ios::binary | std::ios::ate);
+		std::streamoff fileSize = file ? (std::streamoff)file.tellg() : 0;
+		file.seekg(0);
+		EntryHeader header;
+		if (!file.read((char*)&header, sizeof(header)) || header.magic != MAGIC || header.key != key) {
+			misses++;
+			return false;
+		}
+		//A truncated or corrupt entry must not turn into a huge allocation, the binary has to fit in the file
+		if (header.length == 0 || (uint64_t)header.length > (uint64_t)(fileSize - (std::streamoff)sizeof(header))) {
+			misses++;
+			return false;
+		}
+		std::vector<char> binary(header.length);
+		if (!file.read(binary.data(), header.length)) {
+			misses++;
+			return false;
+		}
+
+		programBinary(program, header.format, binary.data(), (GLsizei)header.length);
+		int success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			rejected++;
+			misses++;
+			remove(entryPath(key).c_str());
+			return false;
+		}
+
+		double loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		hits++;
+		millisecondsSaved += header.compileMilliseconds - loadTime;
+		return true;
+	}
+
+	//Call after a successful link from source, compileMilliseconds is what the hit will be saving next run
+	void store(unsigned int program, uint64_t key, double compileMilliseconds) {
+		if (!enabled) {
+			return;
+		}
+		int length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) {
+			return;
+		}
+		std::vector<char> binary(length);
+		EntryHeader header;
+		header.magic = MAGIC;
+		header.key = key;
+		header.compileMilliseconds = compileMilliseconds;
+		GLsizei written = 0;
+		getProgramBinary(program, length, &written, &header.format, binary.data());
+		header.length = (uint32_t)written;
+
+		std::ofstream file(entryPath(key), std::ios::binary | std::ios::trunc);
+		file.write((const char*)&header, sizeof(header));
+		file.write(binary.data(), written);
+		if (!file) {
+			std::cout << "ERROR::SHADER_CACHE::FILE_NOT_SUCCESFULLY_WRITTEN" << std::endl;
+		}
+	}
+
+	void printStats() const {
+		std::cout << "SHADER_CACHE: " << hits << " hits, " << misses << " misses (" << rejected << " rejected), "
+			<< millisecondsSaved << " ms saved" << std::endl;
+	}
+
+private:
+	static const uint32_t MAGIC = 0x48435347; //"GSCH"
+
+	struct EntryHeader {
+		uint32_t magic;
+		GLenum format;
+		uint64_t key;
+		double compileMilliseconds;
+		uint32_t length;
+		uint32_t padding = 0;
+	};
+
+	std::string directory;
+	std::string driver;
+	bool enabled = false;
+	PFNCACHEGETPROGRAMBINARYPROC getProgramBinary = NULL;
+	PFNCACHEPROGRAMBINARYPROC programBinary = NULL;
+	PFNCACHEPROGRAMPARAMETERIPROC programParameteri = NULL;
+
+	static void hashBytes(uint64_t& hash, const char* bytes, size_t length) {
+		for (size_t i = 0; i < length; i++) {
+			hash = (hash ^ (unsigned char)bytes[i]) * 1099511628211ull;
+		}
+		//Separator so ("ab", "c") and ("a", "bc") don't collide
+		hash = (hash ^ 0xff) * 1099511628211ull;
+	}
+
+	std::string entryPath(uint64_t key) const {
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+		return directory + "/" + name;
+	}
+};
+
+#endif // !SHADERCACHE_H
@@ -0,0 +1,216 @@
+#ifndef SHADERCOMPILER_H
+
+#define SHADERCOMPILER_H
+
+#include <glad/glad.h>
+#include "GLExtensions.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRYP PFNCOMPILERMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+
+//Compiles and links many programs without waiting on each one.
+//Everything is submitted to the driver up front and the status queries (which are what actually block)
+//are deferred until the program is needed. With KHR/ARB_parallel_shader_compile the driver spreads
+//the work across its own threads and isReady() never blocks; without it isReady() finishes the program.
+//Programs belong to the compiler until detach(), release() a handle once it isn't needed so its slot is reused.
+class ShaderCompiler {
+public:
+	ShaderCompiler() {}
+	ShaderCompiler(const ShaderCompiler&) = delete;
+	ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+	//Deletes everything still held: shaders of unfinished programs and programs that were never detached
+	~ShaderCompiler() {
+		for (unsigned int i = 0; i < programs.size(); i++) {
+			if (programs[i].used) {
+				release(i);
+			}
+		}
+	}
+
+	//Call after gladLoadGLLoader, with the same loader
+	void init(GLADloadproc load) {
+		PFNCOMPILERMAXSHADERCOMPILERTHREADSPROC maxThreads = NULL;
+		if (hasGLExtension("GL_KHR_parallel_shader_compile")) {
+			maxThreads = (PFNCOMPILERMAXSHADERCOMPILERTHREADSPROC)load("glMaxShaderCompilerThreadsKHR");
+		}
+		else if (hasGLExtension("GL_ARB_parallel_shader_compile")) {
+			maxThreads = (PFNCOMPILERMAXSHADERCOMPILERTHREADSPROC)load("glMaxShaderCompilerThreadsARB");
+		}
+		parallel = maxThreads != NULL;
+		if (parallel) {
+			//0xFFFFFFFF lets the driver pick, usually one thread per core
+			maxThreads(0xFFFFFFFF);
+		}
+	}
+
+	bool isParallel() const {
+		return parallel;
+	}
+
+	//Queues a program and returns a handle for it, the sources are copied by glShaderSource so they can be freed after
+	unsigned int submit(const char* vertexSource, const char* fragmentSource, const char* name) {
+		//A negative length tells GL the string is null terminated
+		return submit(vertexSource, -1, fragmentSource, -1, name);
+	}
+
+	//Same as above for sources that aren't null terminated (like a MappedFile)
+	unsigned int submit(const char* vertexSource, int vertexLength, const char* fragmentSource, int fragmentLength, const char* name) {
+		PendingProgram pending;
+		pending.name = name;
+		pending.vertex = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(pending.vertex, 1, &vertexSource, &vertexLength);
+		glCompileShader(pending.vertex);
+		pending.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(pending.fragment, 1, &fragmentSource, &fragmentLength);
+		glCompileShader(pending.fragment);
+
+		//Linking right away is fine, the driver waits for the compiles itself
+		pending.program = glCreateProgram();
+		glAttachShader(pending.program, pending.vertex);
+		glAttachShader(pending.program, pending.fragment);
+		glLinkProgram(pending.program);
+
+		if (!freeHandles.empty()) {
+			unsigned int handle = freeHandles.back();
+			freeHandles.pop_back();
+			programs[handle] = pending;
+			return handle;
+		}
+		programs.push_back(pending);
+		return (unsigned int)programs.size() - 1;
+	}
+
+	//Hands the program object over to the caller (valid even if the link failed), the compiler won't delete it.
+	//The handle keeps working until release()
+	unsigned int detach(unsigned int handle) {
+		programs[handle].detached = true;
+		return programs[handle].program;
+	}
+
+	//Done with handle: the shaders go, the program too unless it was detached, and the slot is reused by submit()
+	void release(unsigned int handle) {
+		PendingProgram& pending = programs[handle];
+		if (!pending.finished) {
+			glDeleteShader(pending.vertex);
+			glDeleteShader(pending.fragment);
+		}
+		if (!pending.detached) {
+			glDeleteProgram(pending.program);
+		}
+		pending = PendingProgram();
+		pending.used = false;
+		freeHandles.push_back(handle);
+	}
+
+	//Non-blocking when the driver supports parallel compile
+	bool isReady(unsigned int handle) {
+		PendingProgram& pending = programs[handle];
+		if (pending.finished) {
+			return true;
+		}
+		if (parallel) {
+			int complete = 0;
+			glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &complete);
+			if (!complete) {
+				return false;
+			}
+		}
+		finish(pending);
+		return true;
+	}
+
+	//Returns 0 if the program failed to link
+	unsigned int wait(unsigned int handle) {
+		finish(programs[handle]);
+		return programs[handle].success ? programs[handle].program : 0;
+	}
+
+	void waitAll() {
+		for (PendingProgram& pending : programs) {
+			if (pending.used) {
+				finish(pending);
+			}
+		}
+	}
+
+	//Raw program object, valid even if the link failed. Still owned by the compiler, see detach()
+	unsigned int getProgram(unsigned int handle) const {
+		return programs[handle].program;
+	}
+
+	//The program if it is linked, otherwise fallback, so the render loop can keep drawing meanwhile
+	unsigned int programOr(unsigned int handle, unsigned int fallback) {
+		if (!isReady(handle) || !programs[handle].success) {
+			return fallback;
+		}
+		return programs[handle].program;
+	}
+
+	unsigned int pendingCount() {
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < programs.size(); i++) {
+			if (programs[i].used && !isReady(i)) {
+				count++;
+			}
+		}
+		return count;
+	}
+
+private:
+	struct PendingProgram {
+		std::string name;
+		unsigned int program = 0;
+		unsigned int vertex = 0;
+		unsigned int fragment = 0;
+		bool finished = false;
+		bool success = false;
+		bool detached = false;
+		bool used = true;
+	};
+
+	std::vector<PendingProgram> programs;
+	//Released slots, reused before programs grows
+	std::vector<unsigned int> freeHandles;
+	bool parallel = false;
+
+	void finish(PendingProgram& pending) {
+		if (pending.finished) {
+			return;
+		}
+		int success;
+		char infoLog[512];
+		glGetProgramiv(pending.program, GL_LINK_STATUS, &success);
+		pending.success = success != 0;
+		//Only dig into the individual shaders when something went wrong
+		if (!success) {
+			glGetShaderiv(pending.vertex, GL_COMPILE_STATUS, &success);
+			if (!success) {
+				glGetShaderInfoLog(pending.vertex, 512, NULL, infoLog);
+				std::cout << "ERROR::SHADER::" << pending.name << "::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+			}
+			glGetShaderiv(pending.fragment, GL_COMPILE_STATUS, &success);
+			if (!success) {
+				glGetShaderInfoLog(pending.fragment, 512, NULL, infoLog);
+				std::cout << "ERROR::SHADER::" << pending.name << "::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+			}
+			glGetProgramInfoLog(pending.program, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::" << pending.name << "::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		}
+		glDeleteShader(pending.vertex);
+		glDeleteShader(pending.fragment);
+		pending.finished = true;
+	}
+};
+
+#endif // !SHADERCOMPILER_H
@@ -0,0 +1,346 @@
+#ifndef SHADERPREPROCESSOR_H
+
+#define SHADERPREPROCESSOR_H
+
+#include "Shader.h"
+#include "MappedFile.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cctype>
+
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
+
+//Resolves #include "file" (relative to the including file) and injects #defines right after #version,
+//which GLSL requires to stay the first line. Every file is given its own source string number in the
+//#line directives, so driver errors read "<file number>(<line>)" and point at the right place.
+class ShaderPreprocessor {
+public:
+	//Returns an empty string if a file couldn't be read
+	std::string expand(const std::string& path, const ShaderDefines& defines) {
+		files.clear();
+		std::string output;
+		if (!expandFile(normalizePath(path), defines, true, output, 0)) {
+			return std::string();
+		}
+		return output;
+	}
+
+	//Source string number used in #line for each file of the last expand()
+	const std::vector<std::string>& getFiles() const {
+		return files;
+	}
+
+private:
+	static const int MAX_INCLUDE_DEPTH = 32;
+	std::vector<std::string> files;
+
+	static std::string directoryOf(const std::string& path) {
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+	//Collapses "." and ".." segments and uses '/' throughout, so every spelling of a file compares equal
+	static std::string normalizePath(const std::string& path) {
+		bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+		std::vector<std::string> segments;
+		size_t start = 0;
+		while (start <= path.size()) {
+			size_t slash = path.find_first_of("/\\", start);
+			if (slash == std::string::npos) {
+				slash = path.size();
+			}
+			std::string segment = path.substr(start, slash - start);
+			if (segment == "..") {
+				if (!segments.empty() && segments.back() != "..") {
+					segments.pop_back();
+				}
+				else if (!absolute) {
+					//Above the starting directory, has to stay
+					segments.push_back(segment);
+				}
+			}
+			else if (!segment.empty() && segment != ".") {
+				segments.push_back(segment);
+			}
+			start = slash + 1;
+		}
+		std::string result = absolute ? "/" : "";
+		for (size_t i = 0; i < segments.size(); i++) {
+			result += (i > 0 ? "/" : "") + segments[i];
+		}
+		return result;
+	}
+
+	//Skips spaces/tabs and returns true if the line continues with the directive
+	static bool startsWithDirective(const char* line, const char* end, const char* directive, const char** after) {
+		while (line < end && (*line == ' ' || *line == '\t')) {
+			line++;
+		}
+		if (line == end || *line != '#') {
+			return false;
+		}
+		line++;
+		while (line < end && (*line == ' ' || *line == '\t')) {
+			line++;
+		}
+		size_t length = strlen(directive);
+		if ((size_t)(end - line) < length || strncmp(line, directive, length) != 0) {
+			return false;
+		}
+		*after = line + length;
+		return true;
+	}
+
+	bool expandFile(const std::string& path, const ShaderDefines& defines, bool root, std::string& output, int depth) {
+		if (depth > MAX_INCLUDE_DEPTH) {
+			std::cout << "ERROR::SHADER::PREPROCESSOR::INCLUDE_TOO_DEEP\n" << path << std::endl;
+			return false;
+		}
+		MappedFile source(path.c_str());
+		if (!source.isOpen()) {
+			std::cout << "ERROR::SHADER::PREPROCESSOR::FILE_NOT_SUCCESFULLY_READ\n" << path << std::endl;
+			return false;
+		}
+		int fileNumber = (int)files.size();
+		files.push_back(path);
+		output.reserve(output.size() + source.size());
+
+		const char* data = source.data();
+		const char* end = data + source.size();
+		bool injectDefines = root;
+		int lineNumber = 1;
+		//The defines go right after the line holding #version, which may come after comments and blank lines
+		const char* versionLineEnd = NULL;
+		if (root && !defines.empty()) {
+			const char* version = skipCommentsAndSpace(data, end);
+			const char* lineEnd = std::find(version, end, '\n');
+			const char* after;
+			if (startsWithDirective(version, lineEnd, "version", &after)) {
+				versionLineEnd = lineEnd != end ? lineEnd + 1 : end;
+			}
+			else {
+				//No #version line means the defines go first
+				appendDefines(defines, output);
+				output += "#line 1 " + std::to_string(fileNumber) + "\n";
+				injectDefines = false;
+			}
+		}
+
+		for (const char* line = data; line < end; lineNumber++) {
+			const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+			const char* next = lineEnd != NULL ? lineEnd + 1 : end;
+			if (lineEnd == NULL) {
+				lineEnd = end;
+			}
+			const char* after;
+			if (startsWithDirective(line, lineEnd, "include", &after)) {
+				const char* open = after;
+				while (open < lineEnd && *open != '"' && *open != '<') {
+					open++;
+				}
+				char close = (open < lineEnd && *open == '<') ? '>' : '"';
+				const char* closing = open < lineEnd ? (const char*)memchr(open + 1, close, lineEnd - open - 1) : NULL;
+				if (closing == NULL) {
+					std::cout << "ERROR::SHADER::PREPROCESSOR::BAD_INCLUDE\n" << path << "(" << lineNumber << ")" << std::endl;
+					return false;
+				}
+				std::string includePath = normalizePath(directoryOf(path) + std::string(open + 1, closing));
+				//Every file is pasted at most once, like an implicit #pragma once, which also breaks include cycles
+				if (isIncluded(includePath)) {
+					output += '\n';
+				}
+				else {
+					output += "#line 1 " + std::to_string(files.size()) + "\n";
+					if (!expandFile(includePath, defines, false, output, depth + 1)) {
+						return false;
+					}
+					output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileNumber) + "\n";
+				}
+			}
+			else {
+				output.append(line, next);
+				if (lineEnd == end) {
+					output += '\n';
+				}
+				if (injectDefines && next == versionLineEnd) {
+					appendDefines(defines, output);
+					output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileNumber) + "\n";
+					injectDefines = false;
+				}
+			}
+			line = next;
+		}
+		return true;
+	}
+
+	//Skips whitespace, newlines and // or /* */ comments, all GLSL allows before #version
+	static const char* skipCommentsAndSpace(const char* text, const char* end) {
+		while (text < end) {
+			if (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') {
+				text++;
+			}
+			else if (end - text >= 2 && text[0] == '/' && text[1] == '/') {
+				const char* lineEnd = (const char*)memchr(text, '\n', end - text);
+				text = lineEnd != NULL ? lineEnd : end;
+			}
+			else if (end - text >= 2 && text[0] == '/' && text[1] == '*') {
+				const char* close = text + 2;
+				while (close + 1 < end && !(close[0] == '*' && close[1] == '/')) {
+					close++;
+				}
+				text = close + 1 < end ? close + 2 : end;
+			}
+			else {
+				break;
+			}
+		}
+		return text;
+	}
+
+	bool isIncluded(const std::string& path) const {
+		for (const std::string& file : files) {
+			if (file == path) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static void appendDefines(const ShaderDefines& defines, std::string& output) {
+		for (const std::pair<std::string, std::string>& define : defines) {
+			output += "#define " + define.first + " " + define.second + "\n";
+		}
+	}
+};
+
+//Every combination of a set of options, built from one vertex/fragment pair.
+//Each option becomes a #define, so the variants are specialized at compile time instead of branching
+//on uniforms. A stage only gets the defines it mentions, so combinations that differ only in options
+//neither stage uses expand to the exact same source and share a single program.
+class ShaderVariants {
+public:
+	unsigned int uniquePrograms = 0;
+
+	ShaderVariants(const char* vertexPath, const char* fragmentPath) : vertexPath(vertexPath), fragmentPath(fragmentPath) {}
+
+	//Adds a #define NAME VALUE axis, every value is combined with every value of the other options
+	void addOption(const std::string& name, const std::vector<std::string>& values) {
+		if (values.empty()) {
+			return;
+		}
+		options.push_back(std::make_pair(name, values));
+	}
+
+	//Keys look like "NAME=VALUE,OTHER=VALUE" in the order the options were added
+	void build(ShaderCache* cache = NULL) {
+		ShaderPreprocessor preprocessor;
+		std::vector<bool> vertexUses = referencedOptions(preprocessor, vertexPath);
+		std::vector<bool> fragmentUses = referencedOptions(preprocessor, fragmentPath);
+		//Expanded vertex + fragment source -> index into shaders
+		std::unordered_map<std::string, size_t> bySource;
+		std::vector<size_t> choice(options.size(), 0);
+
+		while (true) {
+			ShaderDefines vertexDefines;
+			ShaderDefines fragmentDefines;
+			std::string key;
+			for (size_t i = 0; i < options.size(); i++) {
+				std::pair<std::string, std::string> define(options[i].first, options[i].second[choice[i]]);
+				if (vertexUses[i]) {
+					vertexDefines.push_back(define);
+				}
+				if (fragmentUses[i]) {
+					fragmentDefines.push_back(define);
+				}
+				key += (i > 0 ? "," : "") + options[i].first + "=" + options[i].second[choice[i]];
+			}
+
+			std::string vertexCode = preprocessor.expand(vertexPath, vertexDefines);
+			std::string fragmentCode = preprocessor.expand(fragmentPath, fragmentDefines);
+			//Length prefix keeps the boundary between the two stages unambiguous
+			std::string combined = std::to_string(vertexCode.size()) + ":" + vertexCode + fragmentCode;
+			auto found = bySource.find(combined);
+			if (found == bySource.end()) {
+				shaders.push_back(Shader(vertexCode, fragmentCode, cache));
+				found = bySource.emplace(std::move(combined), shaders.size() - 1).first;
+			}
+			variants[key] = found->second;
+
+			//Advance to the next combination like an odometer
+			size_t axis = 0;
+			while (axis < options.size() && ++choice[axis] == options[axis].second.size()) {
+				choice[axis] = 0;
+				axis++;
+			}
+			if (axis == options.size()) {
+				break;
+			}
+		}
+		uniquePrograms = (unsigned int)shaders.size();
+	}
+
+	//Returns NULL if no variant has that key
+	Shader* get(const std::string& key) {
+		auto found = variants.find(key);
+		return found == variants.end() ? NULL : &shaders[found->second];
+	}
+
+	size_t variantCount() const {
+		return variants.size();
+	}
+
+private:
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::vector<std::pair<std::string, std::vector<std::string>>> options;
+	std::vector<Shader> shaders;
+	std::map<std::string, size_t> variants;
+
+	static void addIdentifiers(const std::string& text, std::unordered_set<std::string>& identifiers) {
+		for (size_t i = 0; i < text.size(); ) {
+			if (isalpha((unsigned char)text[i]) || text[i] == '_') {
+				size_t start = i;
+				while (i < text.size() && (isalnum((unsigned char)text[i]) || text[i] == '_')) {
+					i++;
+				}
+				identifiers.insert(text.substr(start, i - start));
+			}
+			else {
+				i++;
+			}
+		}
+	}
+
+	//Which options the stage (with its includes) mentions, or that the value of a mentioned option mentions.
+	//Comments count too, an option that is only mentioned there costs a duplicate program but nothing breaks
+	std::vector<bool> referencedOptions(ShaderPreprocessor& preprocessor, const std::string& path) const {
+		std::unordered_set<std::string> identifiers;
+		addIdentifiers(preprocessor.expand(path, ShaderDefines()), identifiers);
+		std::vector<bool> used(options.size(), false);
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (size_t i = 0; i < options.size(); i++) {
+				if (used[i] || identifiers.count(options[i].first) == 0) {
+					continue;
+				}
+				used[i] = true;
+				changed = true;
+				for (const std::string& value : options[i].second) {
+					addIdentifiers(value, identifiers);
+				}
+			}
+		}
+		return used;
+	}
+};
+
+#endif // !SHADERPREPROCESSOR_H
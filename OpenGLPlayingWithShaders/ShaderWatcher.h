@@ -0,0 +1,240 @@
+#ifndef SHADERWATCHER_H
+
+#define SHADERWATCHER_H
+
+#include <glad/glad.h>
+#include "Shader.h"
+#include "ShaderCompiler.h"
+#include "MappedFile.h"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <limits.h>
+#endif
+
+//Hot reload for Shader objects.
+//Call update() once per frame: edited files are recompiled through a ShaderCompiler, and the Shader's
+//program is only swapped once the new one has linked, so a broken edit keeps the old program running.
+//Linux uses inotify, other platforms fall back to polling the file modification times.
+//Watched Shaders can be moved or destroyed freely, they tell the watcher (see ShaderObserver).
+class ShaderWatcher : public ShaderObserver {
+public:
+	ShaderWatcher() {}
+	ShaderWatcher(const ShaderWatcher&) = delete;
+	ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+	~ShaderWatcher() {
+		for (WatchedShader& watched : shaders) {
+			watched.shader->setObserver(NULL);
+		}
+#ifdef __linux__
+		if (inotifyFd != -1) {
+			close(inotifyFd);
+		}
+#endif
+	}
+
+	//Call after gladLoadGLLoader, with the same loader. state is the cache the watched programs are drawn through,
+	//it has to forget a program when a reload deletes it
+	void init(GLADloadproc load, GLStateCache* state = NULL) {
+		this->state = state;
+		compiler.init(load);
+#ifdef __linux__
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotifyFd == -1) {
+			std::cout << "WARNING::SHADER_WATCHER::INOTIFY_FAILED, polling instead" << std::endl;
+		}
+#endif
+	}
+
+	void watch(Shader& shader) {
+		//Shaders built from memory have nothing to watch
+		if (shader.vertexPath.empty() || shader.fragmentPath.empty()) {
+			return;
+		}
+		//Watching it twice would reload and swap it twice on every change
+		for (const WatchedShader& watched : shaders) {
+			if (watched.shader == &shader) {
+				return;
+			}
+		}
+		WatchedShader watched;
+		watched.shader = &shader;
+		shader.setObserver(this);
+		watched.vertexTime = modifiedTime(shader.vertexPath);
+		watched.fragmentTime = modifiedTime(shader.fragmentPath);
+		shaders.push_back(watched);
+#ifdef __linux__
+		//Editors usually save by writing a new file and renaming it over the old one, which would drop a
+		//watch on the file itself, so the directory is watched instead
+		addDirectoryWatch(shader.vertexPath);
+		addDirectoryWatch(shader.fragmentPath);
+#endif
+	}
+
+	void update() {
+		detectChanges();
+
+		for (WatchedShader& watched : shaders) {
+			if (watched.pending) {
+				if (!compiler.isReady(watched.handle)) {
+					continue;
+				}
+				watched.pending = false;
+				if (compiler.wait(watched.handle) != 0) {
+					//The Shader owns the program from here on
+					watched.shader->swapProgram(compiler.detach(watched.handle), state);
+					std::cout << "SHADER_WATCHER: reloaded " << watched.shader->fragmentPath << std::endl;
+				}
+				else {
+					std::cout << "SHADER_WATCHER: keeping the previous program" << std::endl;
+				}
+				//Frees the failed program, and the slot either way, so reloads don't pile up in the compiler
+				compiler.release(watched.handle);
+			}
+			//A save that happened while the last rebuild was in flight starts another one
+			if (watched.dirty && !watched.pending) {
+				watched.dirty = false;
+				MappedFile vertexFile(watched.shader->vertexPath.c_str());
+				MappedFile fragmentFile(watched.shader->fragmentPath.c_str());
+				if (!vertexFile.isOpen() || !fragmentFile.isOpen()) {
+					//Probably caught halfway through a save, the next event will retry
+					continue;
+				}
+				watched.handle = compiler.submit(vertexFile.data(), (int)vertexFile.size(), fragmentFile.data(), (int)fragmentFile.size(), "RELOAD");
+				watched.pending = true;
+			}
+		}
+	}
+
+private:
+	struct WatchedShader {
+		Shader* shader;
+		time_t vertexTime;
+		time_t fragmentTime;
+		bool dirty = false;
+		bool pending = false;
+		unsigned int handle = 0;
+	};
+
+	ShaderCompiler compiler;
+	GLStateCache* state = NULL;
+	std::vector<WatchedShader> shaders;
+	std::chrono::steady_clock::time_point lastPoll;
+#ifdef __linux__
+	int inotifyFd = -1;
+	std::vector<int> directoryWatches;
+#endif
+
+	void shaderMoved(Shader* from, Shader* to) override {
+		for (size_t i = 0; i < shaders.size(); i++) {
+			if (shaders[i].shader != from) {
+				continue;
+			}
+			if (to != NULL) {
+				shaders[i].shader = to;
+			}
+			else {
+				if (shaders[i].pending) {
+					compiler.release(shaders[i].handle);
+				}
+				shaders.erase(shaders.begin() + i);
+			}
+			return;
+		}
+	}
+
+	static time_t modifiedTime(const std::string& path) {
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0) {
+			return 0;
+		}
+		return info.st_mtime;
+	}
+
+	static std::string directoryOf(const std::string& path) {
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+	}
+
+	static std::string fileNameOf(const std::string& path) {
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? path : path.substr(slash + 1);
+	}
+
+	void detectChanges() {
+#ifdef __linux__
+		if (inotifyFd != -1) {
+			readEvents();
+			return;
+		}
+#endif
+		//Polling fallback, stat() every file a few times per second at most
+		auto now = std::chrono::steady_clock::now();
+		if (now - lastPoll < std::chrono::milliseconds(250)) {
+			return;
+		}
+		lastPoll = now;
+		for (WatchedShader& watched : shaders) {
+			time_t vertexTime = modifiedTime(watched.shader->vertexPath);
+			time_t fragmentTime = modifiedTime(watched.shader->fragmentPath);
+			if (vertexTime != watched.vertexTime || fragmentTime != watched.fragmentTime) {
+				watched.vertexTime = vertexTime;
+				watched.fragmentTime = fragmentTime;
+				watched.dirty = true;
+			}
+		}
+	}
+
+#ifdef __linux__
+	void addDirectoryWatch(const std::string& path) {
+		if (inotifyFd == -1) {
+			return;
+		}
+		int wd = inotify_add_watch(inotifyFd, directoryOf(path).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (wd == -1) {
+			std::cout << "ERROR::SHADER_WATCHER::WATCH_FAILED\n" << path << std::endl;
+			return;
+		}
+		//inotify hands back the same descriptor for a directory that is already watched
+		for (int existing : directoryWatches) {
+			if (existing == wd) {
+				return;
+			}
+		}
+		directoryWatches.push_back(wd);
+	}
+
+	void readEvents() {
+		alignas(struct inotify_event) char buffer[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+		ssize_t length;
+		while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+			for (char* ptr = buffer; ptr < buffer + length; ) {
+				const struct inotify_event* event = (const struct inotify_event*)ptr;
+				if (event->len > 0) {
+					markDirty(event->name);
+				}
+				ptr += sizeof(struct inotify_event) + event->len;
+			}
+		}
+	}
+
+	//Events only carry the file name, so a name shared by two directories reloads both; harmless
+	void markDirty(const char* fileName) {
+		for (WatchedShader& watched : shaders) {
+			if (fileNameOf(watched.shader->vertexPath) == fileName || fileNameOf(watched.shader->fragmentPath) == fileName) {
+				watched.dirty = true;
+			}
+		}
+	}
+#endif
+};
+
+#endif // !SHADERWATCHER_H
@@ -0,0 +1,482 @@
+#ifndef SOFTWARERASTERIZER_H
+
+#define SOFTWARERASTERIZER_H
+
+#include "JobSystem.h"
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SOFTWARE_RASTERIZER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTWARE_RASTERIZER_SSE2
+#endif
+
+//Where a draw reads its vertices: 3 floats of position (NDC, z is ignored, there is no depth test) and
+//optionally 3 floats of color, at byte offsets inside one vertex of "stride" bytes. colorOffset -1 draws
+//every pixel in flatColor instead, like the customColor uniform programs do.
+struct SoftwareVertexInput {
+	const void* vertices;
+	unsigned int stride;
+	unsigned int positionOffset;
+	int colorOffset;
+	float flatColor[4];
+};
+
+//Draws triangles on the CPU the way the GL paths of the executables do (glDrawArrays / glDrawElements with
+//GL_TRIANGLES, per-vertex colors or one flat color, no depth test or blending), for machines without a GL
+//driver and as a reference image for regression tests.
+//The framebuffer is cut into 64x64 tiles. A draw first sets up and bins its triangles into the tiles they
+//touch, spread over the job threads, then every tile is rasterized by one thread, going through its
+//triangles in draw order. Edge functions are evaluated in fixed point (4 subpixel bits, pixel centers,
+//top-left fill rule) and colors with the same float operations in every lane, so the image is the same for
+//any thread count and for the AVX2, SSE2 and plain C++ paths.
+//Vertices must land within 8192 pixels of the framebuffer, triangles past that are skipped and counted.
+class SoftwareRasterizer {
+public:
+	//Triangles skipped for being outside the guard band or the framebuffer, or having no area
+	unsigned int rejectedTriangles = 0;
+
+	//threadCount as in JobSystem::init, 0 uses every hardware thread
+	bool create(int width, int height, unsigned int threadCount = 0) {
+		if (width <= 0 || height <= 0 || width > GUARD_BAND || height > GUARD_BAND) {
+			std::cout << "ERROR::SOFTWARE_RASTERIZER::INVALID_SIZE\n" << width << "x" << height << std::endl;
+			return false;
+		}
+		this->width = width;
+		this->height = height;
+		tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+		tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+		color.assign((size_t)width * height, 0);
+		jobs.init(threadCount);
+		return true;
+	}
+
+	int getWidth() const {
+		return width;
+	}
+
+	int getHeight() const {
+		return height;
+	}
+
+	//RGBA8 pixels, rows from the bottom like glReadPixels
+	const uint32_t* pixels() const {
+		return color.data();
+	}
+
+	void clear(float r, float g, float b, float a) {
+		uint32_t value = packColor(r, g, b, a);
+		std::fill(color.begin(), color.end(), value);
+	}
+
+	//glDrawArrays(GL_TRIANGLES, first, count)
+	void drawArrays(const SoftwareVertexInput& input, unsigned int first, unsigned int count) {
+		draw(input, NULL, first, count);
+	}
+
+	//glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, indices)
+	void drawElements(const SoftwareVertexInput& input, const unsigned int* indices, unsigned int count) {
+		draw(input, indices, 0, count);
+	}
+
+	//Writes the framebuffer as a binary PPM, the same format as RenderContext::capture
+	bool capture(const char* path) const {
+		FILE* file = fopen(path, "wb");
+		if (file == NULL) {
+			std::cout << "ERROR::SOFTWARE_RASTERIZER::CAPTURE_FAILED\n" << path << std::endl;
+			return false;
+		}
+		fprintf(file, "P6\n%d %d\n255\n", width, height);
+		std::vector<unsigned char> row((size_t)width * 3);
+		for (int y = height - 1; y >= 0; y--) {
+			const uint32_t* source = color.data() + (size_t)y * width;
+			for (int x = 0; x < width; x++) {
+				row[x * 3] = (unsigned char)(source[x] & 0xFF);
+				row[x * 3 + 1] = (unsigned char)((source[x] >> 8) & 0xFF);
+				row[x * 3 + 2] = (unsigned char)((source[x] >> 16) & 0xFF);
+			}
+			fwrite(row.data(), 1, row.size(), file);
+		}
+		fclose(file);
+		return true;
+	}
+
+private:
+	static const int TILE_SIZE = 64;
+	static const int SUBPIXEL_BITS = 4;
+	static const int SUBPIXEL = 1 << SUBPIXEL_BITS;
+	//In pixels. Keeps every edge function value the rasterizer steps through inside 32 bits
+	static const int GUARD_BAND = 8192;
+
+	//One triangle after setup, everything in framebuffer space
+	struct Triangle {
+		//Fixed point vertex positions
+		int x[3];
+		int y[3];
+		//Pixel bounding box, x1 and y1 exclusive
+		int minX, minY, maxX, maxY;
+		//Color = base + dx * x + dy * y for r, g, b, a at a pixel center (x, y)
+		float base[4];
+		float dx[4];
+		float dy[4];
+		bool visible;
+	};
+
+	int width = 0;
+	int height = 0;
+	int tilesX = 0;
+	int tilesY = 0;
+	std::vector<uint32_t> color;
+	JobSystem jobs;
+	std::vector<Triangle> triangles;
+	//bins[chunk][tile], triangle indices in draw order. Every setup chunk has its own bins, so binning needs no
+	//locks, and reading them chunk by chunk keeps draw order
+	std::vector<std::vector<std::vector<uint32_t>>> bins;
+
+	static uint32_t packColor(float r, float g, float b, float a) {
+		return (uint32_t)toByte(r) | ((uint32_t)toByte(g) << 8) | ((uint32_t)toByte(b) << 16) | ((uint32_t)toByte(a) << 24);
+	}
+
+	//Same steps as the lane version: clamp, scale and round to nearest even (the default rounding mode), which
+	//is what GL drivers do for unorm8, e.g. 0.3 gives 76 and not 77
+	static int toByte(float value) {
+		value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+		return (int)lrintf(value * 255.0f);
+	}
+
+	void draw(const SoftwareVertexInput& input, const unsigned int* indices, unsigned int first, unsigned int count) {
+		unsigned int triangleCount = count / 3;
+		if (triangleCount == 0) {
+			return;
+		}
+		triangles.resize(triangleCount);
+		unsigned int grain = triangleCount / (jobs.threadCount() * 4);
+		if (grain < 256) {
+			grain = 256;
+		}
+		unsigned int chunks = (triangleCount + grain - 1) / grain;
+		size_t tileCount = (size_t)tilesX * tilesY;
+		if (bins.size() < chunks) {
+			bins.resize(chunks);
+		}
+		for (unsigned int chunk = 0; chunk < chunks; chunk++) {
+			bins[chunk].resize(tileCount);
+			for (std::vector<uint32_t>& bin : bins[chunk]) {
+				bin.clear();
+			}
+		}
+
+		jobs.parallelFor(triangleCount, grain, [&](unsigned int begin, unsigned int end) {
+			std::vector<std::vector<uint32_t>>& chunkBins = bins[begin / grain];
+			for (unsigned int t = begin; t < end; t++) {
+				Triangle& triangle = triangles[t];
+				unsigned int vertex[3];
+				for (int k = 0; k < 3; k++) {
+					vertex[k] = indices != NULL ? indices[t * 3 + k] : first + t * 3 + k;
+				}
+				setup(input, vertex, triangle);
+				if (!triangle.visible) {
+					continue;
+				}
+				for (int ty = triangle.minY / TILE_SIZE; ty <= (triangle.maxY - 1) / TILE_SIZE; ty++) {
+					for (int tx = triangle.minX / TILE_SIZE; tx <= (triangle.maxX - 1) / TILE_SIZE; tx++) {
+						chunkBins[ty * tilesX + tx].push_back(t);
+					}
+				}
+			}
+		});
+		for (unsigned int t = 0; t < triangleCount; t++) {
+			rejectedTriangles += triangles[t].visible ? 0 : 1;
+		}
+
+		jobs.parallelFor((unsigned int)tileCount, 1, [&](unsigned int begin, unsigned int end) {
+			for (unsigned int tile = begin; tile < end; tile++) {
+				for (unsigned int chunk = 0; chunk < chunks; chunk++) {
+					for (uint32_t t : bins[chunk][tile]) {
+						rasterize(triangles[t], tile);
+					}
+				}
+			}
+		});
+	}
+
+	void setup(const SoftwareVertexInput& input, const unsigned int* vertex, Triangle& triangle) const {
+		const unsigned char* base = (const unsigned char*)input.vertices;
+		float colors[3][4];
+		triangle.visible = false;
+		for (int k = 0; k < 3; k++) {
+			const unsigned char* source = base + (size_t)vertex[k] * input.stride;
+			float position[3];
+			memcpy(position, source + input.positionOffset, sizeof(position));
+			//Viewport transform, snapped to the subpixel grid
+			double screenX = (position[0] * 0.5 + 0.5) * width;
+			double screenY = (position[1] * 0.5 + 0.5) * height;
+			if (!(fabs(screenX) < GUARD_BAND && fabs(screenY) < GUARD_BAND)) {
+				return;
+			}
+			triangle.x[k] = (int)floor(screenX * SUBPIXEL + 0.5);
+			triangle.y[k] = (int)floor(screenY * SUBPIXEL + 0.5);
+			if (input.colorOffset >= 0) {
+				memcpy(colors[k], source + input.colorOffset, 3 * sizeof(float));
+				colors[k][3] = 1.0f;
+			}
+			else {
+				memcpy(colors[k], input.flatColor, sizeof(input.flatColor));
+			}
+		}
+
+		//No face culling in GL by default, so clockwise triangles are turned around instead of dropped
+		int64_t area = (int64_t)(triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0])
+			- (int64_t)(triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+		if (area == 0) {
+			return;
+		}
+		if (area < 0) {
+			std::swap(triangle.x[1], triangle.x[2]);
+			std::swap(triangle.y[1], triangle.y[2]);
+			for (int c = 0; c < 4; c++) {
+				std::swap(colors[1][c], colors[2][c]);
+			}
+		}
+
+		//Pixels whose center can be covered, clamped to the framebuffer
+		int minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+		int maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+		int minY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+		int maxY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+		triangle.minX = std::max(0, floorDiv(minX - SUBPIXEL / 2, SUBPIXEL));
+		triangle.minY = std::max(0, floorDiv(minY - SUBPIXEL / 2, SUBPIXEL));
+		triangle.maxX = std::min(width, floorDiv(maxX - SUBPIXEL / 2, SUBPIXEL) + 1);
+		triangle.maxY = std::min(height, floorDiv(maxY - SUBPIXEL / 2, SUBPIXEL) + 1);
+		if (triangle.minX >= triangle.maxX || triangle.minY >= triangle.maxY) {
+			return;
+		}
+
+		//Color plane through the three (snapped) vertices
+		float x0 = (float)triangle.x[0] / SUBPIXEL, y0 = (float)triangle.y[0] / SUBPIXEL;
+		float x1 = (float)triangle.x[1] / SUBPIXEL - x0, y1 = (float)triangle.y[1] / SUBPIXEL - y0;
+		float x2 = (float)triangle.x[2] / SUBPIXEL - x0, y2 = (float)triangle.y[2] / SUBPIXEL - y0;
+		float inverseDeterminant = 1.0f / (x1 * y2 - x2 * y1);
+		for (int c = 0; c < 4; c++) {
+			float c1 = colors[1][c] - colors[0][c];
+			float c2 = colors[2][c] - colors[0][c];
+			triangle.dx[c] = (c1 * y2 - c2 * y1) * inverseDeterminant;
+			triangle.dy[c] = (c2 * x1 - c1 * x2) * inverseDeterminant;
+			triangle.base[c] = colors[0][c] - triangle.dx[c] * x0 - triangle.dy[c] * y0;
+		}
+		triangle.visible = true;
+	}
+
+	static int floorDiv(int value, int divisor) {
+		return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+	}
+
+	//One edge of a triangle inside one tile: value at the first pixel of the region (bias included, inside
+	//when >= 0) and how much it changes per pixel
+	struct EdgeStep {
+		int32_t start;
+		int32_t stepX;
+		int32_t stepY;
+	};
+
+	//Returns false if the whole region is outside this edge
+	static bool setupEdge(int ax, int ay, int bx, int by, int regionX, int regionY, int regionW, int regionH, EdgeStep& edge) {
+		int64_t a = (int64_t)ay - by;
+		int64_t b = (int64_t)bx - ax;
+		//Top-left rule: pixels exactly on a right or bottom edge belong to the neighbouring triangle
+		int64_t bias = (a > 0 || (a == 0 && b < 0)) ? 0 : -1;
+		int64_t px = (int64_t)regionX * SUBPIXEL + SUBPIXEL / 2 - ax;
+		int64_t py = (int64_t)regionY * SUBPIXEL + SUBPIXEL / 2 - ay;
+		int64_t start = a * px + b * py + bias;
+		int64_t spanX = a * (regionW - 1) * SUBPIXEL;
+		int64_t spanY = b * (regionH - 1) * SUBPIXEL;
+		int64_t low = start + std::min<int64_t>(spanX, 0) + std::min<int64_t>(spanY, 0);
+		int64_t high = start + std::max<int64_t>(spanX, 0) + std::max<int64_t>(spanY, 0);
+		if (high < 0) {
+			return false;
+		}
+		if (low >= 0) {
+			//Covers the whole region, no need to step it (and its values may not fit 32 bits)
+			edge.start = 0;
+			edge.stepX = 0;
+			edge.stepY = 0;
+			return true;
+		}
+		//The edge crosses the region, so the values here stay within a tile's span of zero
+		edge.start = (int32_t)start;
+		edge.stepX = (int32_t)(a * SUBPIXEL);
+		edge.stepY = (int32_t)(b * SUBPIXEL);
+		return true;
+	}
+
+	void rasterize(const Triangle& triangle, unsigned int tile) {
+		int tileX = (int)(tile % tilesX) * TILE_SIZE;
+		int tileY = (int)(tile / tilesX) * TILE_SIZE;
+		int regionX = std::max(tileX, triangle.minX);
+		int regionY = std::max(tileY, triangle.minY);
+		int regionW = std::min(tileX + TILE_SIZE, triangle.maxX) - regionX;
+		int regionH = std::min(tileY + TILE_SIZE, triangle.maxY) - regionY;
+		if (regionW <= 0 || regionH <= 0) {
+			return;
+		}
+		EdgeStep edges[3];
+		for (int k = 0; k < 3; k++) {
+			int next = (k + 1) % 3;
+			if (!setupEdge(triangle.x[k], triangle.y[k], triangle.x[next], triangle.y[next], regionX, regionY, regionW, regionH, edges[k])) {
+				return;
+			}
+		}
+
+		Lanes lanes(edges, triangle);
+		for (int y = 0; y < regionH; y++) {
+			int32_t row[3];
+			for (int k = 0; k < 3; k++) {
+				row[k] = edges[k].start + edges[k].stepY * y;
+			}
+			uint32_t* destination = color.data() + (size_t)(regionY + y) * width + regionX;
+			float centerY = (float)(regionY + y) + 0.5f;
+			for (int x = 0; x < regionW; x += Lanes::WIDTH) {
+				int count = regionW - x;
+				if (count > Lanes::WIDTH) {
+					count = Lanes::WIDTH;
+				}
+				lanes.shade(row, (float)(regionX + x) + 0.5f, centerY, count, destination + x);
+				for (int k = 0; k < 3; k++) {
+					row[k] += edges[k].stepX * Lanes::WIDTH;
+				}
+			}
+		}
+	}
+
+	//Shades Lanes::WIDTH pixels of a row at once: coverage from the three edge values, color from the planes.
+	//Every implementation does the same operations in the same order per pixel, so they give the same bytes
+#if defined(SOFTWARE_RASTERIZER_AVX2)
+	struct Lanes {
+		static const int WIDTH = 8;
+		__m256i offsets[3];
+		__m256 dx[4], dy[4], base[4];
+
+		Lanes(const EdgeStep* edges, const Triangle& triangle) {
+			for (int k = 0; k < 3; k++) {
+				int s = edges[k].stepX;
+				offsets[k] = _mm256_setr_epi32(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+			}
+			for (int c = 0; c < 4; c++) {
+				dx[c] = _mm256_set1_ps(triangle.dx[c]);
+				dy[c] = _mm256_set1_ps(triangle.dy[c]);
+				base[c] = _mm256_set1_ps(triangle.base[c]);
+			}
+		}
+
+		void shade(const int32_t* row, float x, float y, int count, uint32_t* destination) const {
+			__m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+			__m256i signs = _mm256_or_si256(_mm256_or_si256(
+				_mm256_add_epi32(_mm256_set1_epi32(row[0]), offsets[0]),
+				_mm256_add_epi32(_mm256_set1_epi32(row[1]), offsets[1])),
+				_mm256_add_epi32(_mm256_set1_epi32(row[2]), offsets[2]));
+			__m256i mask = _mm256_andnot_si256(_mm256_srai_epi32(signs, 31), _mm256_cmpgt_epi32(_mm256_set1_epi32(count), index));
+			if (_mm256_movemask_epi8(mask) == 0) {
+				return;
+			}
+			__m256 centerX = _mm256_add_ps(_mm256_set1_ps(x), _mm256_cvtepi32_ps(index));
+			__m256 centerY = _mm256_set1_ps(y);
+			__m256i packed = _mm256_setzero_si256();
+			for (int c = 0; c < 4; c++) {
+				__m256 value = _mm256_add_ps(_mm256_add_ps(base[c], _mm256_mul_ps(dx[c], centerX)), _mm256_mul_ps(dy[c], centerY));
+				value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+				__m256i byte = _mm256_cvtps_epi32(_mm256_mul_ps(value, _mm256_set1_ps(255.0f)));
+				packed = _mm256_or_si256(packed, _mm256_slli_epi32(byte, c * 8));
+			}
+			//Masked lanes are neither written nor read, so a span may run past the region's right end
+			_mm256_maskstore_epi32((int*)destination, mask, packed);
+		}
+	};
+#elif defined(SOFTWARE_RASTERIZER_SSE2)
+	struct Lanes {
+		static const int WIDTH = 4;
+		__m128i offsets[3];
+		__m128 dx[4], dy[4], base[4];
+
+		Lanes(const EdgeStep* edges, const Triangle& triangle) {
+			for (int k = 0; k < 3; k++) {
+				int s = edges[k].stepX;
+				offsets[k] = _mm_setr_epi32(0, s, 2 * s, 3 * s);
+			}
+			for (int c = 0; c < 4; c++) {
+				dx[c] = _mm_set1_ps(triangle.dx[c]);
+				dy[c] = _mm_set1_ps(triangle.dy[c]);
+				base[c] = _mm_set1_ps(triangle.base[c]);
+			}
+		}
+
+		void shade(const int32_t* row, float x, float y, int count, uint32_t* destination) const {
+			__m128i index = _mm_setr_epi32(0, 1, 2, 3);
+			__m128i signs = _mm_or_si128(_mm_or_si128(
+				_mm_add_epi32(_mm_set1_epi32(row[0]), offsets[0]),
+				_mm_add_epi32(_mm_set1_epi32(row[1]), offsets[1])),
+				_mm_add_epi32(_mm_set1_epi32(row[2]), offsets[2]));
+			__m128i mask = _mm_andnot_si128(_mm_srai_epi32(signs, 31), _mm_cmpgt_epi32(_mm_set1_epi32(count), index));
+			int bits = _mm_movemask_ps(_mm_castsi128_ps(mask));
+			if (bits == 0) {
+				return;
+			}
+			__m128 centerX = _mm_add_ps(_mm_set1_ps(x), _mm_cvtepi32_ps(index));
+			__m128 centerY = _mm_set1_ps(y);
+			__m128i packed = _mm_setzero_si128();
+			for (int c = 0; c < 4; c++) {
+				__m128 value = _mm_add_ps(_mm_add_ps(base[c], _mm_mul_ps(dx[c], centerX)), _mm_mul_ps(dy[c], centerY));
+				value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+				__m128i byte = _mm_cvtps_epi32(_mm_mul_ps(value, _mm_set1_ps(255.0f)));
+				packed = _mm_or_si128(packed, _mm_slli_epi32(byte, c * 8));
+			}
+			//Partial spans at the region's right end must not touch the pixels past it
+			if (bits == 0xF) {
+				_mm_storeu_si128((__m128i*)destination, packed);
+				return;
+			}
+			uint32_t values[4];
+			_mm_storeu_si128((__m128i*)values, packed);
+			for (int i = 0; i < 4; i++) {
+				if (bits & (1 << i)) {
+					destination[i] = values[i];
+				}
+			}
+		}
+	};
+#else
+	struct Lanes {
+		static const int WIDTH = 4;
+		const EdgeStep* edges;
+		const Triangle& triangle;
+
+		Lanes(const EdgeStep* edges, const Triangle& triangle) : edges(edges), triangle(triangle) {}
+
+		void shade(const int32_t* row, float x, float y, int count, uint32_t* destination) const {
+			for (int i = 0; i < count; i++) {
+				int32_t signs = (row[0] + edges[0].stepX * i) | (row[1] + edges[1].stepX * i) | (row[2] + edges[2].stepX * i);
+				if (signs < 0) {
+					continue;
+				}
+				float centerX = x + (float)i;
+				uint32_t packed = 0;
+				for (int c = 0; c < 4; c++) {
+					float value = (triangle.base[c] + triangle.dx[c] * centerX) + triangle.dy[c] * y;
+					packed |= (uint32_t)toByte(value) << (c * 8);
+				}
+				destination[i] = packed;
+			}
+		}
+	};
+#endif
+};
+
+#endif // !SOFTWARERASTERIZER_H
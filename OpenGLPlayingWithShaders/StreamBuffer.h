@@ -0,0 +1,156 @@
+#ifndef STREAMBUFFER_H
+
+#define STREAMBUFFER_H
+
+#include <glad/glad.h>
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+#include "GLHandles.h"
+
+#include <iostream>
+#include <cstdint>
+
+//ARB_buffer_storage (core in 4.4) isn't part of the GLAD 3.3 loader
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (APIENTRYP PFNSTREAMBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+//Ring buffer for data that is rewritten every frame (dynamic vertices, instance data, uniform blocks).
+//The buffer is split in one region per frame in flight, each region is fenced when the frame ends,
+//and a region is only written again once the GPU has passed its fence. That way the driver never has
+//to synchronize or reallocate behind our back.
+//With buffer storage the whole buffer is mapped once, persistently and coherently. On plain GL 3.3
+//each region is mapped with UNSYNCHRONIZED | INVALIDATE_RANGE (safe because of our own fences) and
+//has to be unmapped with flush() before drawing from it.
+class StreamBuffer {
+public:
+	BufferHandle ID;
+	//Times beginFrame() actually had to wait for the GPU, non-zero means too few frames in flight
+	unsigned int fenceWaits = 0;
+
+	//Call after gladLoadGLLoader, with the same loader
+	void init(GLADloadproc load, GLStateCache& state, GLenum target, GLsizeiptr bytesPerFrame, int framesInFlight = 3) {
+		this->target = target;
+		regionSize = bytesPerFrame;
+		regionCount = framesInFlight < MAX_FRAMES ? framesInFlight : MAX_FRAMES;
+
+		PFNSTREAMBUFFERSTORAGEPROC bufferStorage = NULL;
+		if (hasGLVersion(4, 4) || hasGLExtension("GL_ARB_buffer_storage")) {
+			bufferStorage = (PFNSTREAMBUFFERSTORAGEPROC)load("glBufferStorage");
+		}
+
+		ID = BufferHandle::create(&state);
+		state.bindBuffer(target, ID.get());
+		GLsizeiptr totalSize = regionSize * regionCount;
+		if (bufferStorage != NULL) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			bufferStorage(target, totalSize, NULL, flags);
+			persistent = (char*)glMapBufferRange(target, 0, totalSize, flags);
+			if (persistent == NULL) {
+				std::cout << "ERROR::STREAM_BUFFER::PERSISTENT_MAP_FAILED" << std::endl;
+			}
+		}
+		else {
+			glBufferData(target, totalSize, NULL, GL_STREAM_DRAW);
+		}
+	}
+
+	//Deleting the buffer also unmaps it, only the fences are left to free
+	~StreamBuffer() {
+		for (int i = 0; i < MAX_FRAMES; i++) {
+			if (fences[i] != NULL) {
+				glDeleteSync(fences[i]);
+			}
+		}
+	}
+
+	bool isPersistent() const {
+		return persistent != NULL;
+	}
+
+	//Call once per frame before the first allocate()
+	void beginFrame() {
+		GLsync& fence = fences[region];
+		if (fence != NULL) {
+			//Cheap check first, only count it as a wait if the GPU really is behind
+			GLenum result = glClientWaitSync(fence, 0, 0);
+			if (result == GL_TIMEOUT_EXPIRED) {
+				fenceWaits++;
+				while (result == GL_TIMEOUT_EXPIRED) {
+					result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+				}
+			}
+			glDeleteSync(fence);
+			fence = NULL;
+		}
+		head = 0;
+	}
+
+	//Returns where to write size bytes, offset is where they live inside ID (for glVertexAttribPointer,
+	//glBindBufferRange...). Returns NULL if this frame's region is full.
+	void* allocate(GLStateCache& state, GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset) {
+		//Aligned inside the whole buffer, not the region: bytesPerFrame needn't be a multiple of the alignment
+		//(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT for glBindBufferRange, say)
+		GLsizeiptr regionStart = region * regionSize;
+		GLsizeiptr start = (regionStart + head + alignment - 1) / alignment * alignment - regionStart;
+		if (start + size > regionSize) {
+			std::cout << "ERROR::STREAM_BUFFER::FRAME_REGION_FULL" << std::endl;
+			return NULL;
+		}
+		head = start + size;
+		offset = regionStart + start;
+		if (persistent != NULL) {
+			return persistent + offset;
+		}
+
+		//Map everything left in this frame's region at once, so a frame normally needs a single map
+		if (mapped == NULL) {
+			state.bindBuffer(target, ID.get());
+			mappedStart = offset;
+			mapped = (char*)glMapBufferRange(target, mappedStart, (region + 1) * regionSize - mappedStart,
+				GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+			mappedEnd = mappedStart;
+		}
+		mappedEnd = offset + size;
+		return mapped + (offset - mappedStart);
+	}
+
+	//Makes everything allocated so far visible to GL, required before drawing on the GL 3.3 path
+	void flush(GLStateCache& state) {
+		if (mapped == NULL) {
+			return;
+		}
+		state.bindBuffer(target, ID.get());
+		glFlushMappedBufferRange(target, 0, mappedEnd - mappedStart);
+		glUnmapBuffer(target);
+		mapped = NULL;
+	}
+
+	//Call after the last draw that reads this frame's data
+	void endFrame(GLStateCache& state) {
+		flush(state);
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		region = (region + 1) % regionCount;
+	}
+
+private:
+	static const int MAX_FRAMES = 4;
+
+	GLenum target = GL_ARRAY_BUFFER;
+	GLsizeiptr regionSize = 0;
+	int regionCount = 0;
+	int region = 0;
+	GLsizeiptr head = 0;
+	GLsync fences[MAX_FRAMES] = {};
+	char* persistent = NULL;
+	char* mapped = NULL;
+	GLintptr mappedStart = 0;
+	GLintptr mappedEnd = 0;
+};
+
+#endif // !STREAMBUFFER_H
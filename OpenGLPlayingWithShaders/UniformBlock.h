@@ -0,0 +1,70 @@
+#ifndef UNIFORMBLOCK_H
+
+#define UNIFORMBLOCK_H
+
+#include <glad/glad.h>
+#include "GLStateCache.h"
+#include "GLHandles.h"
+#include "Shader.h"
+
+#include <string>
+
+//C++ types with the std140 alignment rules, build block structs out of these (plus float/int) so the
+//struct layout matches "layout (std140) uniform Block { ... }" member for member.
+//std140 lets a scalar share the last 4 bytes of a vec3, C++ can't, so don't put a float after a vec3.
+namespace std140 {
+	struct alignas(8) vec2 {
+		float x, y;
+	};
+	struct alignas(16) vec3 {
+		float x, y, z;
+	};
+	struct alignas(16) vec4 {
+		float x, y, z, w;
+	};
+	//Column major, like GLSL
+	struct alignas(16) mat4 {
+		vec4 columns[4];
+	};
+}
+
+//One uniform block shared by every program that declares it.
+//The C++ struct is uploaded once per frame into a single UBO bound to a fixed binding point, and every
+//program that declares the block is pointed at that binding when it links (hot reloads included).
+//Setting the same values on N programs then costs one buffer update instead of N * members glUniform calls.
+//Create the block before building the shaders that use it, or call attach() on them afterwards.
+template <typename T>
+class UniformBlock {
+public:
+	BufferHandle UBO;
+	T data;
+
+	UniformBlock(const char* blockName, unsigned int binding) : data(), blockName(blockName), binding(binding) {}
+
+	void create(GLStateCache& state) {
+		UBO = BufferHandle::create(&state);
+		state.bindBuffer(GL_UNIFORM_BUFFER, UBO.get());
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(T), &data, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, UBO.get());
+		Shader::registerUniformBlock(blockName, binding, sizeof(T));
+	}
+
+	//For programs linked before create()
+	void attach(const Shader& shader) const {
+		shader.bindUniformBlocks();
+	}
+
+	//Uploads data, call once per frame after changing it
+	void upload(GLStateCache& state) {
+		state.bindBuffer(GL_UNIFORM_BUFFER, UBO.get());
+		//Orphan first, so a draw from last frame still reading the buffer doesn't stall us
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+	}
+
+private:
+	std::string blockName;
+	unsigned int binding;
+};
+
+#endif // !UNIFORMBLOCK_H
@@ -0,0 +1,275 @@
+#ifndef VERTEXFORMAT_H
+
+#define VERTEXFORMAT_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#if defined(__F16C__) || defined(__AVX2__)
+#include <immintrin.h>
+#define VERTEX_FORMAT_F16C
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VERTEX_FORMAT_SSE2
+#endif
+
+//Same arguments as glVertexAttribPointer, offset is in bytes inside one vertex
+struct VertexAttribute {
+	unsigned int index;
+	int size;
+	GLenum type;
+	bool normalized;
+	unsigned int offset;
+};
+
+//Bulk converters from float arrays to the packed GPU formats. Every path rounds to nearest even, so the SIMD
+//and plain versions give the same bits
+namespace VertexConvert {
+	//IEEE half, overflow goes to infinity, NaN stays NaN
+	inline uint16_t toHalf(float value) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		uint32_t sign = bits & 0x80000000u;
+		bits ^= sign;
+		uint32_t half;
+		if (bits >= 0x47800000u) {
+			//65536 and up (or infinity, NaN)
+			half = bits > 0x7F800000u ? 0x7E00u : 0x7C00u;
+		}
+		else if (bits < 0x38800000u) {
+			//Below the smallest normal half, let a float add do the rounding into the denormal range
+			float magnitude;
+			memcpy(&magnitude, &bits, sizeof(magnitude));
+			magnitude += 0.5f;
+			memcpy(&half, &magnitude, sizeof(half));
+			half -= 0x3F000000u;
+		}
+		else {
+			//Rebias the exponent and round the mantissa, ties to even
+			uint32_t odd = (bits >> 13) & 1;
+			bits += 0xC8000FFFu + odd;
+			half = bits >> 13;
+		}
+		return (uint16_t)(half | (sign >> 16));
+	}
+
+	inline void toHalf(const float* source, uint16_t* destination, size_t count) {
+		size_t i = 0;
+#if defined(VERTEX_FORMAT_F16C)
+		for (; i + 8 <= count; i += 8) {
+			__m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT);
+			//The hardware keeps the top of a NaN's payload, clear it so NaN is 0x7E00 (plus sign) like the other paths
+			__m128i nan = _mm_cmpgt_epi16(_mm_and_si128(halves, _mm_set1_epi16(0x7FFF)), _mm_set1_epi16(0x7C00));
+			halves = _mm_andnot_si128(_mm_and_si128(nan, _mm_set1_epi16(0x01FF)), halves);
+			_mm_storeu_si128((__m128i*)(destination + i), halves);
+		}
+#elif defined(VERTEX_FORMAT_SSE2)
+		const __m128i signMask = _mm_set1_epi32((int)0x80000000u);
+		for (; i + 4 <= count; i += 4) {
+			__m128i bits = _mm_castps_si128(_mm_loadu_ps(source + i));
+			__m128i sign = _mm_and_si128(bits, signMask);
+			bits = _mm_xor_si128(bits, sign);
+			__m128i overflow = _mm_cmpgt_epi32(bits, _mm_set1_epi32(0x477FFFFF));
+			__m128i infinity = _mm_or_si128(_mm_set1_epi32(0x7C00),
+				_mm_and_si128(_mm_cmpgt_epi32(bits, _mm_set1_epi32(0x7F800000)), _mm_set1_epi32(0x0200)));
+			__m128i denormal = _mm_cmplt_epi32(bits, _mm_set1_epi32(0x38800000));
+			__m128i small = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(bits), _mm_set1_ps(0.5f))), _mm_set1_epi32(0x3F000000));
+			__m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+			__m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32((int)0xC8000FFFu)), odd), 13);
+			__m128i half = _mm_or_si128(_mm_and_si128(denormal, small), _mm_andnot_si128(denormal, normal));
+			half = _mm_or_si128(_mm_and_si128(overflow, infinity), _mm_andnot_si128(overflow, half));
+			half = _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+			//Sign extend so the saturating pack keeps the low 16 bits as they are
+			half = _mm_srai_epi32(_mm_slli_epi32(half, 16), 16);
+			_mm_storel_epi64((__m128i*)(destination + i), _mm_packs_epi32(half, half));
+		}
+#endif
+		for (; i < count; i++) {
+			destination[i] = toHalf(source[i]);
+		}
+	}
+
+	//[0, 1] to 0..255
+	inline uint8_t toUNorm8(float value) {
+		value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+		return (uint8_t)lrintf(value * 255.0f);
+	}
+
+	inline void toUNorm8(const float* source, uint8_t* destination, size_t count) {
+		size_t i = 0;
+#if defined(VERTEX_FORMAT_SSE2)
+		for (; i + 4 <= count; i += 4) {
+			__m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+			__m128i words = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(value, _mm_set1_ps(255.0f))), _mm_setzero_si128());
+			int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+			memcpy(destination + i, &bytes, 4);
+		}
+#endif
+		for (; i < count; i++) {
+			destination[i] = toUNorm8(source[i]);
+		}
+	}
+
+	//x, y, z in [-1, 1] to 10 bits each and w in [-1, 1] to 2 bits, GL_INT_2_10_10_10_REV normalized
+	inline uint32_t toSNorm10_10_10_2(const float* xyzw) {
+		static const float scale[4] = { 511.0f, 511.0f, 511.0f, 1.0f };
+		static const uint32_t mask[4] = { 0x3FF, 0x3FF, 0x3FF, 0x3 };
+		uint32_t packed = 0;
+		for (int c = 0; c < 4; c++) {
+			float value = xyzw[c] < -1.0f ? -1.0f : (xyzw[c] > 1.0f ? 1.0f : xyzw[c]);
+			packed |= ((uint32_t)lrintf(value * scale[c]) & mask[c]) << (c * 10);
+		}
+		return packed;
+	}
+
+	//count vectors of 4 floats
+	inline void toSNorm10_10_10_2(const float* source, uint32_t* destination, size_t count) {
+		size_t i = 0;
+#if defined(VERTEX_FORMAT_SSE2)
+		const __m128 scale = _mm_setr_ps(511.0f, 511.0f, 511.0f, 1.0f);
+		const __m128i mask = _mm_setr_epi32(0x3FF, 0x3FF, 0x3FF, 0x3);
+		for (; i < count; i++) {
+			__m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i * 4), _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+			uint32_t fields[4];
+			_mm_storeu_si128((__m128i*)fields, _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(value, scale)), mask));
+			destination[i] = fields[0] | (fields[1] << 10) | (fields[2] << 20) | (fields[3] << 30);
+		}
+#endif
+		for (; i < count; i++) {
+			destination[i] = toSNorm10_10_10_2(source + i * 4);
+		}
+	}
+}
+
+//Describes how float vertex data is stored on the GPU, attribute by attribute, and packs it.
+//Attributes are laid out in the order they are added, each 4 byte aligned, the stride rounded up to 4.
+//	Float			4 bytes per component, as before
+//	Half			GL_HALF_FLOAT, 2 bytes, ~3 significant digits (fine for positions of small meshes)
+//	UNorm8			GL_UNSIGNED_BYTE normalized, 1 byte, [0, 1] (colors)
+//	SNorm10_10_10_2	GL_INT_2_10_10_10_REV normalized, 4 bytes for up to 4 components in [-1, 1] (normals)
+//Position + color as Half + UNorm8 is 12 bytes instead of 24.
+class VertexFormat {
+public:
+	enum Type {
+		Float,
+		Half,
+		UNorm8,
+		SNorm10_10_10_2
+	};
+
+	//components floats of the source vertex, following the previous attribute's
+	void addAttribute(unsigned int index, int components, Type type) {
+		Attribute attribute = { index, components, type, alignedStride(), sourceFloats };
+		attributes.push_back(attribute);
+		sourceFloats += components;
+	}
+
+	unsigned int getStride() const {
+		return alignedStride();
+	}
+
+	//Floats per source vertex the attributes read
+	unsigned int getSourceFloats() const {
+		return sourceFloats;
+	}
+
+	//For Renderer::createMesh or MeshBatcher::addAttribute
+	std::vector<VertexAttribute> getAttributes() const {
+		std::vector<VertexAttribute> result;
+		for (const Attribute& attribute : attributes) {
+			VertexAttribute vertexAttribute = { attribute.index, attribute.type == SNorm10_10_10_2 ? 4 : attribute.components,
+				glType(attribute.type), attribute.type == UNorm8 || attribute.type == SNorm10_10_10_2, attribute.offset };
+			result.push_back(vertexAttribute);
+		}
+		return result;
+	}
+
+	//source holds vertexCount vertices of sourceStride floats each (the attributes start at float 0)
+	void pack(const float* source, unsigned int sourceStride, unsigned int vertexCount, std::vector<unsigned char>& out) const {
+		unsigned int stride = getStride();
+		out.assign((size_t)stride * vertexCount, 0);
+		std::vector<float> column;
+		std::vector<unsigned char> packed;
+		for (const Attribute& attribute : attributes) {
+			//Gather the attribute into one contiguous array so the converters can run whole vectors at once
+			int components = attribute.type == SNorm10_10_10_2 ? 4 : attribute.components;
+			column.assign((size_t)vertexCount * components, 0.0f);
+			for (unsigned int v = 0; v < vertexCount; v++) {
+				memcpy(&column[(size_t)v * components], source + (size_t)v * sourceStride + attribute.sourceOffset,
+					attribute.components * sizeof(float));
+			}
+			size_t size = byteSize(attribute);
+			packed.resize(size * vertexCount);
+			switch (attribute.type) {
+			case Float:
+				memcpy(packed.data(), column.data(), packed.size());
+				break;
+			case Half:
+				VertexConvert::toHalf(column.data(), (uint16_t*)packed.data(), column.size());
+				break;
+			case UNorm8:
+				VertexConvert::toUNorm8(column.data(), packed.data(), column.size());
+				break;
+			case SNorm10_10_10_2:
+				VertexConvert::toSNorm10_10_10_2(column.data(), (uint32_t*)packed.data(), vertexCount);
+				break;
+			}
+			for (unsigned int v = 0; v < vertexCount; v++) {
+				memcpy(&out[(size_t)v * stride + attribute.offset], &packed[v * size], size);
+			}
+		}
+	}
+
+private:
+	struct Attribute {
+		unsigned int index;
+		int components;
+		Type type;
+		unsigned int offset;
+		unsigned int sourceOffset;
+	};
+
+	std::vector<Attribute> attributes;
+	unsigned int sourceFloats = 0;
+
+	static GLenum glType(Type type) {
+		switch (type) {
+		case Half:
+			return GL_HALF_FLOAT;
+		case UNorm8:
+			return GL_UNSIGNED_BYTE;
+		case SNorm10_10_10_2:
+			return GL_INT_2_10_10_10_REV;
+		default:
+			return GL_FLOAT;
+		}
+	}
+
+	static size_t byteSize(const Attribute& attribute) {
+		switch (attribute.type) {
+		case Half:
+			return attribute.components * 2;
+		case UNorm8:
+			return attribute.components;
+		case SNorm10_10_10_2:
+			return 4;
+		default:
+			return attribute.components * 4;
+		}
+	}
+
+	unsigned int alignedStride() const {
+		if (attributes.empty()) {
+			return 0;
+		}
+		const Attribute& last = attributes.back();
+		return (unsigned int)((last.offset + byteSize(last) + 3) & ~(size_t)3);
+	}
+};
+
+#endif // !VERTEXFORMAT_H
@@ -0,0 +1,304 @@
+#ifndef VERTEXLAYOUT_H
+
+#define VERTEXLAYOUT_H
+
+#include <glad/glad.h>
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+#include "VertexFormat.h"
+
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+
+//ARB_vertex_attrib_binding (core in 4.3) isn't part of the GLAD 3.3 loader
+typedef void (APIENTRYP PFNVERTEXLAYOUTATTRIBFORMATPROC)(GLuint attribIndex, GLint size, GLenum type, GLboolean normalized, GLuint relativeOffset);
+typedef void (APIENTRYP PFNVERTEXLAYOUTATTRIBBINDINGPROC)(GLuint attribIndex, GLuint bindingIndex);
+typedef void (APIENTRYP PFNVERTEXLAYOUTBINDVERTEXBUFFERPROC)(GLuint bindingIndex, GLuint buffer, GLintptr offset, GLsizei stride);
+
+//The separate attribute format entry points, shared by every VertexLayout. Without them layouts fall back to
+//glVertexAttribPointer, which ties the format to the buffer and has to be issued again for each buffer
+struct VertexAttribBinding {
+	PFNVERTEXLAYOUTATTRIBFORMATPROC attribFormat = NULL;
+	PFNVERTEXLAYOUTATTRIBBINDINGPROC attribBinding = NULL;
+	PFNVERTEXLAYOUTBINDVERTEXBUFFERPROC bindVertexBuffer = NULL;
+
+	static VertexAttribBinding& get() {
+		static VertexAttribBinding functions;
+		return functions;
+	}
+
+	//Call after gladLoadGLLoader with the same loader (Renderer::init does), returns whether they are available
+	static bool init(GLADloadproc load) {
+		VertexAttribBinding& functions = get();
+		functions = VertexAttribBinding();
+		if (hasGLVersion(4, 3) || hasGLExtension("GL_ARB_vertex_attrib_binding")) {
+			functions.attribFormat = (PFNVERTEXLAYOUTATTRIBFORMATPROC)load("glVertexAttribFormat");
+			functions.attribBinding = (PFNVERTEXLAYOUTATTRIBBINDINGPROC)load("glVertexAttribBinding");
+			functions.bindVertexBuffer = (PFNVERTEXLAYOUTBINDVERTEXBUFFERPROC)load("glBindVertexBuffer");
+			if (functions.attribFormat == NULL || functions.attribBinding == NULL || functions.bindVertexBuffer == NULL) {
+				functions = VertexAttribBinding();
+			}
+		}
+		return functions.isAvailable();
+	}
+
+	bool isAvailable() const {
+		return bindVertexBuffer != NULL;
+	}
+};
+
+//Storage types for Attr, the same ones VertexFormat packs to
+namespace VertexType {
+	struct Float {
+		static constexpr GLenum glType = GL_FLOAT;
+		static constexpr unsigned int componentBytes = 4;
+		static constexpr bool normalized = false;
+		static constexpr bool packed = false;
+		static constexpr VertexFormat::Type format = VertexFormat::Float;
+	};
+	struct Half {
+		static constexpr GLenum glType = GL_HALF_FLOAT;
+		static constexpr unsigned int componentBytes = 2;
+		static constexpr bool normalized = false;
+		static constexpr bool packed = false;
+		static constexpr VertexFormat::Type format = VertexFormat::Half;
+	};
+	struct UNorm8 {
+		static constexpr GLenum glType = GL_UNSIGNED_BYTE;
+		static constexpr unsigned int componentBytes = 1;
+		static constexpr bool normalized = true;
+		static constexpr bool packed = false;
+		static constexpr VertexFormat::Type format = VertexFormat::UNorm8;
+	};
+	//Always 4 bytes and 4 components on the GPU, 3 source components get w = 0
+	struct SNorm10_10_10_2 {
+		static constexpr GLenum glType = GL_INT_2_10_10_10_REV;
+		static constexpr unsigned int componentBytes = 1;
+		static constexpr bool normalized = true;
+		static constexpr bool packed = true;
+		static constexpr VertexFormat::Type format = VertexFormat::SNorm10_10_10_2;
+	};
+}
+
+//One attribute of a VertexLayout: shader location, components and how they are stored
+template <unsigned int Location, int Components, typename Type = VertexType::Float>
+struct Attr {
+	static_assert(Components >= 1 && Components <= 4, "Attr needs 1 to 4 components");
+	static_assert(Location < 16, "Only locations 0 to 15 are guaranteed to exist");
+	static_assert(!Type::packed || Components >= 3, "10_10_10_2 needs 3 or 4 components");
+
+	static constexpr unsigned int location = Location;
+	static constexpr int components = Components;
+	static constexpr int glSize = Type::packed ? 4 : Components;
+	static constexpr GLenum glType = Type::glType;
+	static constexpr bool normalized = Type::normalized;
+	static constexpr unsigned int bytes = Type::packed ? 4 : Components * Type::componentBytes;
+	//Every attribute starts 4 byte aligned, like VertexFormat
+	static constexpr unsigned int alignedBytes = (bytes + 3) & ~3u;
+	typedef Type StorageType;
+};
+
+namespace VertexLayoutDetail {
+	//Byte offset of the attribute at position, the sum of the aligned sizes before it
+	template <typename... Attrs>
+	constexpr unsigned int offsetOf(unsigned int position) {
+		const unsigned int sizes[] = { Attrs::alignedBytes... };
+		unsigned int offset = 0;
+		for (unsigned int i = 0; i < position; i++) {
+			offset += sizes[i];
+		}
+		return offset;
+	}
+
+	template <typename... Attrs>
+	constexpr bool hasUniqueLocations() {
+		const unsigned int locations[] = { Attrs::location... };
+		for (unsigned int i = 0; i < sizeof...(Attrs); i++) {
+			for (unsigned int j = i + 1; j < sizeof...(Attrs); j++) {
+				if (locations[i] == locations[j]) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	//Locations one attribute of the given type fills, matrices take one per column
+	inline int locationCount(GLenum type) {
+		switch (type) {
+		case GL_FLOAT_MAT2:
+		case GL_FLOAT_MAT2x3:
+		case GL_FLOAT_MAT2x4:
+			return 2;
+		case GL_FLOAT_MAT3:
+		case GL_FLOAT_MAT3x2:
+		case GL_FLOAT_MAT3x4:
+			return 3;
+		case GL_FLOAT_MAT4:
+		case GL_FLOAT_MAT4x2:
+		case GL_FLOAT_MAT4x3:
+			return 4;
+		default:
+			return 1;
+		}
+	}
+
+	//Integer inputs need glVertexAttribIPointer/glVertexAttribIFormat, which a layout never emits
+	inline bool isIntegerType(GLenum type) {
+		switch (type) {
+		case GL_INT:
+		case GL_INT_VEC2:
+		case GL_INT_VEC3:
+		case GL_INT_VEC4:
+		case GL_UNSIGNED_INT:
+		case GL_UNSIGNED_INT_VEC2:
+		case GL_UNSIGNED_INT_VEC3:
+		case GL_UNSIGNED_INT_VEC4:
+			return true;
+		default:
+			return false;
+		}
+	}
+}
+
+//A vertex layout fixed at compile time, e.g.
+//	typedef VertexLayout<Attr<0, 3, VertexType::Half>, Attr<1, 3, VertexType::UNorm8>> CompactVertex;
+//Offsets and stride are constants (attributes in order, each 4 byte aligned), mistakes like two attributes on one
+//location fail to compile, and apply() issues exactly one format call and one enable per attribute.
+//With ARB_vertex_attrib_binding the format lives in the VAO apart from the buffer, so meshes with the same layout
+//can share a VAO and switch buffers with a single bindVertexBuffer() call. Without it bindVertexBuffer() issues
+//the glVertexAttribPointer calls again, which still beats a VAO per mesh when most of them go unused.
+//validate() checks a linked program against the layout.
+template <typename... Attrs>
+class VertexLayout {
+	static_assert(sizeof...(Attrs) > 0, "VertexLayout needs at least one attribute");
+	static_assert(VertexLayoutDetail::hasUniqueLocations<Attrs...>(), "Two attributes of a VertexLayout share a location");
+
+public:
+	static constexpr unsigned int attributeCount = sizeof...(Attrs);
+	static constexpr unsigned int stride = VertexLayoutDetail::offsetOf<Attrs...>(sizeof...(Attrs));
+	static_assert(stride <= 2048, "Stride over GL_MAX_VERTEX_ATTRIB_STRIDE's guaranteed minimum");
+
+	static constexpr unsigned int offset(unsigned int position) {
+		return VertexLayoutDetail::offsetOf<Attrs...>(position);
+	}
+
+	//For Renderer::createMesh, MeshBatcher or InstancedMesh
+	static std::vector<VertexAttribute> getAttributes() {
+		std::vector<VertexAttribute> attributes;
+		append(attributes, std::make_index_sequence<sizeof...(Attrs)>());
+		return attributes;
+	}
+
+	//For packing float data into the layout, see VertexFormat::pack
+	static VertexFormat getFormat() {
+		VertexFormat format;
+		int expand[] = { (format.addAttribute(Attrs::location, Attrs::components, Attrs::StorageType::format), 0)... };
+		(void)expand;
+		return format;
+	}
+
+	//Sets the layout up on the bound VAO and reads it from buffer, starting offset bytes in
+	static void apply(GLStateCache& state, unsigned int buffer, GLintptr offset = 0) {
+		const VertexAttribBinding& binding = VertexAttribBinding::get();
+		if (binding.isAvailable()) {
+			setFormats(binding, std::make_index_sequence<sizeof...(Attrs)>());
+			binding.bindVertexBuffer(0, buffer, offset, (GLsizei)stride);
+		}
+		else {
+			state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+			setPointers((uintptr_t)offset, std::make_index_sequence<sizeof...(Attrs)>());
+		}
+		int expand[] = { (glEnableVertexAttribArray(Attrs::location), 0)... };
+		(void)expand;
+	}
+
+	//Points the bound VAO, already set up by apply(), at another buffer with the same layout
+	static void bindVertexBuffer(GLStateCache& state, unsigned int buffer, GLintptr offset = 0) {
+		const VertexAttribBinding& binding = VertexAttribBinding::get();
+		if (binding.isAvailable()) {
+			binding.bindVertexBuffer(0, buffer, offset, (GLsizei)stride);
+		}
+		else {
+			state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+			setPointers((uintptr_t)offset, std::make_index_sequence<sizeof...(Attrs)>());
+		}
+	}
+
+	//Every active input of program must be fed by the layout as a float attribute, errors are printed with name.
+	//Layout attributes the program doesn't read are fine, they are just skipped
+	static bool validate(unsigned int program, const char* name) {
+		int activeCount = 0;
+		glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &activeCount);
+		bool valid = true;
+		for (int i = 0; i < activeCount; i++) {
+			char attributeName[256];
+			GLint arraySize = 0;
+			GLenum type = 0;
+			glGetActiveAttrib(program, (GLuint)i, sizeof(attributeName), NULL, &arraySize, &type, attributeName);
+			//Built-ins like gl_VertexID have no location
+			if (strncmp(attributeName, "gl_", 3) == 0) {
+				continue;
+			}
+			GLint location = glGetAttribLocation(program, attributeName);
+			if (VertexLayoutDetail::isIntegerType(type)) {
+				std::cout << "ERROR::VERTEX_LAYOUT::" << name << "::INTEGER_ATTRIBUTE\n" << attributeName
+					<< " at location " << location << " can't be fed by a float layout" << std::endl;
+				valid = false;
+				continue;
+			}
+			int locations = VertexLayoutDetail::locationCount(type) * arraySize;
+			for (int l = location; l < location + locations; l++) {
+				if (!hasLocation((unsigned int)l)) {
+					std::cout << "ERROR::VERTEX_LAYOUT::" << name << "::MISSING_ATTRIBUTE\n" << attributeName
+						<< " at location " << l << std::endl;
+					valid = false;
+				}
+			}
+		}
+		return valid;
+	}
+
+	static bool hasLocation(unsigned int location) {
+		const unsigned int locations[] = { Attrs::location... };
+		for (unsigned int l : locations) {
+			if (l == location) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	template <size_t... Positions>
+	static void append(std::vector<VertexAttribute>& attributes, std::index_sequence<Positions...>) {
+		int expand[] = { (attributes.push_back(VertexAttribute{ Attrs::location, Attrs::glSize, Attrs::glType,
+			Attrs::normalized, offset(Positions) }), 0)... };
+		(void)expand;
+	}
+
+	template <size_t... Positions>
+	static void setFormats(const VertexAttribBinding& binding, std::index_sequence<Positions...>) {
+		int expand[] = { (binding.attribFormat(Attrs::location, Attrs::glSize, Attrs::glType,
+			Attrs::normalized ? GL_TRUE : GL_FALSE, offset(Positions)), binding.attribBinding(Attrs::location, 0), 0)... };
+		(void)expand;
+	}
+
+	template <size_t... Positions>
+	static void setPointers(uintptr_t base, std::index_sequence<Positions...>) {
+		int expand[] = { (glVertexAttribPointer(Attrs::location, Attrs::glSize, Attrs::glType, Attrs::normalized ? GL_TRUE : GL_FALSE,
+			(GLsizei)stride, (void*)(base + offset(Positions))), 0)... };
+		(void)expand;
+	}
+};
+
+//Static constexpr members still need a definition once they are bound to a reference (C++14)
+template <typename... Attrs>
+constexpr unsigned int VertexLayout<Attrs...>::attributeCount;
+template <typename... Attrs>
+constexpr unsigned int VertexLayout<Attrs...>::stride;
+
+#endif // !VERTEXLAYOUT_H